@@ -1,6 +1,7 @@
 
 #include <Python.h>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -9,6 +10,7 @@
 #include "Planner_Mac.hpp"
 #include "Planner.hpp"
 #include "Core.hpp"
+#include "Trace.hpp"
 
 size_t time_step;
 Environment environment(2);
@@ -33,6 +35,7 @@ std::vector<size_t> list_to_long_vector(PyObject* incoming) {
             data.push_back(PyLong_AsLong(value));
         }
     } else {
+        flush_print();
         std::cout << "Unknown datatype" << std::endl;
         throw std::runtime_error("Unknown datatype");
     }
@@ -52,6 +55,7 @@ std::vector<PyObject*> list_to_action_vector(PyObject* incoming) {
             data.push_back(PyTuple_GetItem(incoming, i));
         }
     } else {
+        flush_print();
         std::cout << "Unknown datatype" << std::endl;
         throw std::runtime_error("Unknown datatype");
     }
@@ -69,13 +73,21 @@ std::string to_string(PyObject* obj) {
 }
 
 PyObject* mac_init(PyObject*, PyObject* o) {
+    flush_print();
     std::cout << "mac_init called" << std::endl;
     set_logging_enabled();
     time_step = 0;
 
+    // Optional, records planner phase spans written next to the log by mac_finish
+    PyObject* trace = PyDict_GetItemString(o, "trace");
+    if (trace != nullptr && PyObject_IsTrue(trace)) {
+        start_trace();
+    }
+
     auto file_name = to_string(PyDict_GetItemString(o, "file_name"));
     file_name = std::string(file_name.begin() + 1, file_name.end() - 1);
     file_name = "utils/levels/" + file_name + ".txt";
+    flush_print();
     std::cout << "mac agent file_name: " << file_name << std::endl;
 
     size_t agent_size = PyLong_AsLong(PyDict_GetItemString(o, "agent_size"));
@@ -83,18 +95,26 @@ PyObject* mac_init(PyObject*, PyObject* o) {
 
     assert(agent_id.id < agent_size);
 
+    // A level the packed state cannot hold raises in Python instead of ending the host process
     environment = Environment(agent_size);
-    state = environment.load(file_name);
+    try {
+        state = environment.load(file_name);
+    } catch (const std::exception& e) {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+        return nullptr;
+    }
 
 
     size_t seed = PyLong_AsLong(PyDict_GetItemString(o, "seed"));
 
     planner = Planner_Mac(environment, agent_id, state, seed);
+    flush_print();
     std::cout << "mac_init finished" << std::endl;
     return PyLong_FromLong(2);
 }
 
 PyObject* mac_finish(PyObject*, PyObject* o) {
+    flush_print();
     std::cout << "mac_finish called" << std::endl;
 
     auto folder_name = to_string(PyDict_GetItemString(o, "file_name"));
@@ -102,6 +122,9 @@ PyObject* mac_finish(PyObject*, PyObject* o) {
     auto full_path = "misc/game/record/" + folder_name + "/mac_log.txt";
 
     flush_log(full_path);
+    if (is_trace_recording()) {
+        write_trace("misc/game/record/" + folder_name + "/mac_trace.json");
+    }
 
     return PyLong_FromLong(2);
 }
@@ -148,6 +171,7 @@ PyObject* mac_update(PyObject*, PyObject* o) {
 }
 
 PyObject* mac_get_next_action(PyObject*, PyObject* o) {
+    flush_print();
     std::cout << "mac_get_next_action called" << std::endl;
 
     // Debug
@@ -1,12 +1,16 @@
 #include "A_Star.hpp"
 #include "Search.hpp"
+#include <chrono>
 #include <queue>
 #include <unordered_set>
 #include <iostream>
 
+constexpr size_t HEURISTIC_CACHE_CAPACITY = 1 << 16;	// Values over all goals kept in GOAL scope
 
-A_Star::A_Star(const Environment& environment, size_t depth_limit) 
-	: Search_Method(environment, depth_limit), dist_heuristic(environment), heuristic(environment) {
+A_Star::A_Star(const Environment& environment, size_t depth_limit, Heuristic_Cache_Scope heuristic_cache_scope,
+	Joint_Expansion joint_expansion) 
+	: Search_Method(environment, depth_limit), dist_heuristic(environment), heuristic(environment),
+	heuristic_cache_scope(heuristic_cache_scope), joint_expansion(joint_expansion) {
 }
 /**
 original_state	Initial state to search from
@@ -15,78 +19,265 @@ agents			All agents allowed to move
 handoff_agent	Agent not allowed to perform the goal action
 input_actions	Fixed initial actions for agents not in free_agents
 free_agents		Agents allowed any move any time
+limits			Tighter depth bound, expansion budget and heuristic weight of an anytime search
 */
 
 std::vector<Joint_Action> A_Star::search_joint(const State& original_state,
 		Recipe recipe, const Agent_Combination& agents, Agent_Id handoff_agent, 
-	const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents, const Action& initial_action) {
+	const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents, const Action& initial_action,
+	Search_Stats* stats, Handoff_Actions* handoff_actions, const Search_Limits& limits) {
 
+	auto time_start = std::chrono::steady_clock::now();
 	heuristic.set(recipe.ingredient1, recipe.ingredient2, agents, handoff_agent);
 	PRINT(Print_Category::A_STAR, Print_Level::VERBOSE, std::string("\n\nStarting search ") 
 		+ recipe.result_char() + " " + agents.to_string() +(handoff_agent.is_empty() ? "" : "/" 
 		+ std::to_string(handoff_agent.id)) + "\n\n");
 	
-	auto actions = get_actions(agents, false);
-	Search_Info si = initialize_variables(recipe, original_state, handoff_agent, agents, input_actions);
+	const auto& actions = get_actions(agents);
+	std::vector<bool> collides;
+	auto& heuristic_cache = get_heuristic_cache(recipe, agents, handoff_agent);
+	Search_Info si = initialize_variables(nodes, recipe, original_state, handoff_agent, agents, input_actions, free_agents, 
+		heuristic_cache, limits);
 
-	while (!si.has_goal_node()) {
+	// Anytime searches go on after the first plan
+	while (!si.has_goal_node() || limits.is_anytime()) {
+		si.stats.peak_frontier = std::max(si.stats.peak_frontier, si.frontier.size());
 
-		// No possible path
+		// No possible path, or no cheaper one
 		auto current_node = get_next_node(si);
 		if (current_node == nullptr) {
-			return {};
+			break;
 		}
+		if (limits.is_anytime() && si.stats.expanded >= limits.expansion_budget) {
+			++si.stats.budget_stops;
+			break;
+		}
+		if (joint_expansion == Joint_Expansion::OPERATOR_DECOMPOSITION) {
+			expand_decomposed(si, current_node, input_actions, initial_action);
+		} else {
+			expand_full(si, current_node, actions, input_actions, initial_action, collides);
+		}
+	}
+	si.stats.peak_visited = si.visited.size();
+	si.stats.time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - time_start).count();
+	if (stats != nullptr) {
+		*stats = si.stats;
+	}
+
+	// No possible path
+	if (si.goal_node == nullptr) {
+		return {};
+	}
+	if (handoff_actions != nullptr) {
+		*handoff_actions = Handoff_Actions(si.goal_node->first_wall_action, si.goal_node->last_wall_action);
+	}
+	print_goal(si, si.goal_node);
+	return extract_actions(si, si.goal_node);
+}
 
-		for (const auto& action : actions) {
+void A_Star::expand_full(Search_Info& si, Node* node, const Joint_Action_Table& actions, 
+	const std::vector<Joint_Action>& input_actions, const Action& initial_action, std::vector<bool>& collides) const {
+	
+	++si.stats.expanded;
 
-			// Fits the requirement for initial actions
-			if (!action_conforms_to_input(current_node, input_actions, action, free_agents, initial_action)) {
-				continue;
-			}
+	// Colliding joint actions would be rejected by act, drop them without copying the state
+	environment.mark_collisions(node->state, actions, collides);
+
+	for (size_t action_index = 0; action_index < actions.size(); ++action_index) {
+		if (collides[action_index]) {
+			continue;
+		}
+		const auto& packed_action = actions.packed_actions[action_index];
 
-			// Perform action if valid
-			auto new_node = check_and_perform(si, action, current_node, input_actions);
-			if (new_node == nullptr) {
-				continue;
+		// Fits the requirement for initial actions
+		if (!action_conforms_to_input(si, node, packed_action, initial_action)) {
+			continue;
+		}
+
+		// Perform action if valid
+		auto new_node = check_and_perform(si, actions.joint_actions[action_index], packed_action, node);
+		if (new_node == nullptr) {
+			continue;
+		}
+		add_successor(si, new_node, packed_action, input_actions);
+	}
+}
+
+/**
+Standley's operator decomposition. Expanding a full node assigns the first goal agent's action,
+expanding an intermediate node the next one, so a node has at most 5 successors and joint
+actions whose first actions look bad are never completed. Agents outside the goal keep NONE.
+Intermediate nodes carry the state with their actions applied in agent order, as act would,
+only to evaluate the heuristic. They are not duplicate checked. The last action completes the
+joint action, which is performed on the full node exactly as in expand_full.
+*/
+void A_Star::expand_decomposed(Search_Info& si, Node* node, const std::vector<Joint_Action>& input_actions, 
+	const Action& initial_action) const {
+
+	const Node* base = node->is_intermediate() ? &si.nodes[node->base] : node;
+	if (!node->is_intermediate()) {
+		++si.stats.expanded;
+	}
+	auto agents = si.agents.get();
+	auto agent = agents.at(node->assigned);
+	bool is_last = node->assigned + 1 == agents.size();
+
+	Packed_Joint_Action partial_action;
+	if (node->is_intermediate()) {
+		partial_action = node->action;
+	} else {
+		for (size_t other = 0; other < environment.get_number_of_agents(); ++other) {
+			if (!si.agents.contains(Agent_Id(other))) {
+				partial_action.set_action({ Direction::NONE, Agent_Id(other) });
 			}
+		}
+	}
 
-			print_current(new_node);
-			if (process_node(si, new_node, action)) {
-				auto handoff_node = generate_handoff(si, new_node, input_actions);
-				if (handoff_node != nullptr) {
-					if (process_node(si, handoff_node, action)) {
-						print_current(handoff_node);
-					}
-				}
+	for (const auto& action : environment.get_actions(agent)) {
+		if (!agent_action_allowed(si, base, partial_action, action, initial_action)) {
+			continue;
+		}
+		auto packed_action = partial_action;
+		packed_action.set_action(action);
+
+		if (is_last) {
+			auto new_node = check_and_perform(si, packed_action.to_joint_action(), packed_action, base);
+			if (new_node != nullptr) {
+				add_successor(si, new_node, packed_action, input_actions);
 			}
+			continue;
 		}
+
+		// From the partial state the remaining actions lower a consistent heuristic by at most 1
+		auto intermediate = si.nodes.allocate();
+		intermediate->init(node);
+		intermediate->base = base->id;
+		intermediate->assigned = node->assigned + 1;
+		intermediate->action = packed_action;
+		intermediate->closed = false;
+		environment.act(intermediate->state, action, Print_Level::NOPE);
+		auto h = get_heuristic(si, intermediate->state);
+		intermediate->h = h == EMPTY_VAL ? base->h : get_weighted(si, std::max<float>(h, 1));
+		++si.stats.intermediate;
+		si.frontier.push(intermediate);
+	}
+}
+
+// The parts of contains_collisions, is_action_valid, the handoff rule of check_and_perform and 
+// action_conforms_to_input which only depend on this agent's action and those in partial_action
+bool A_Star::agent_action_allowed(const Search_Info& si, const Node* base, const Packed_Joint_Action& partial_action, 
+	const Action& action, const Action& initial_action) const {
+	
+	const auto& state = base->state;
+	const auto& agent = action.agent;
+	if (!environment.is_action_valid(state, action)) {
+		return false;
+	}
+
+	if (base->has_agent_passed() 
+		&& si.handoff_agent.is_not_empty() 
+		&& agent == si.handoff_agent
+		&& action.is_not_none()) {
+
+		return false;
 	}
-	if (si.goal_node != nullptr) {
-		print_goal(si.goal_node);
+
+	if (base->g == 0 && initial_action.has_value() && initial_action.agent == agent && action != initial_action) {
+		return false;
+	}
+	if (base->g < si.input_actions.size()) {
+		Packed_Joint_Action packed_action;
+		packed_action.set_action(action);
+		auto field_mask = si.input_masks[base->g] & Packed_Joint_Action::get_field_mask(agent);
+		if (!packed_action.matches(si.input_actions[base->g], field_mask)) {
+			return false;
+		}
+	}
+
+	// A move into the current cell of another agent collides whatever that agent does,
+	// the other rules need both actions
+	auto current = state.get_location(agent);
+	auto next = environment.move(current, action.direction);
+	for (size_t other = 0; other < environment.get_number_of_agents(); ++other) {
+		if (other == agent.id) {
+			continue;
+		}
+		auto other_current = state.get_location(Agent_Id(other));
+		if (next == other_current) {
+			return false;
+		}
+		auto other_field = partial_action.get_field(Agent_Id(other));
+		if (other_field == 0) {
+			continue;
+		}
+		auto other_next = environment.move(other_current, Packed_Joint_Action::to_direction(other_field));
+		if (next == other_next || current == other_next) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void A_Star::add_successor(Search_Info& si, Node* node, const Packed_Joint_Action& action, 
+	const std::vector<Joint_Action>& input_actions) const {
+
+	++si.stats.generated;
+	print_current(node);
+	if (process_node(si, node, action)) {
+		auto handoff_node = generate_handoff(si, node, input_actions);
+		if (handoff_node != nullptr) {
+			++si.stats.generated;
+			if (process_node(si, handoff_node, action)) {
+				print_current(handoff_node);
+			}
+		}
 	}
-	return extract_actions(si.goal_node);
 }
 
 std::pair<size_t, Direction> A_Star::get_dist_direction(Coordinate source, Coordinate dest, size_t walls) {
 	return dist_heuristic.get_dist_direction(source, dest, walls);
 }
 
-bool A_Star::process_node(Search_Info& si, Node* node, const Joint_Action& action) const {
+// All goal caches are dropped together once they exceed HEURISTIC_CACHE_CAPACITY
+Heuristic_Cache& A_Star::get_heuristic_cache(const Recipe& recipe, const Agent_Combination& agents, 
+	const Agent_Id& handoff_agent) {
+
+	if (heuristic_cache_scope == Heuristic_Cache_Scope::SEARCH) {
+		search_heuristic_cache.clear();
+		return search_heuristic_cache;
+	}
+	size_t size = 0;
+	for (const auto& [goal, cache] : goal_heuristic_caches) {
+		size += cache.size();
+	}
+	if (size > HEURISTIC_CACHE_CAPACITY) {
+		goal_heuristic_caches.clear();
+	}
+	return goal_heuristic_caches[{ recipe, agents, handoff_agent }];
+}
+
+bool A_Star::process_node(Search_Info& si, Node* node, const Packed_Joint_Action& action) const {
 	auto& visited = si.visited;
 	auto& frontier = si.frontier;
-	auto& nodes = si.nodes;
 	auto visited_it = visited.find(node);
 
 	// Existing state
 	if (visited_it != visited.end()) {
+		++si.stats.duplicates_merged;
 		if (node->is_shorter(*visited_it)) {
-			(*visited_it)->valid = false;
+			auto old_node = *visited_it;
+			old_node->valid = false;
 			visited.erase(visited_it);
 			visited.insert(node);
-			frontier.push(node);
+			evaluate_heuristic(si, node);
+			if (frontier.contains(old_node)) {
+				frontier.replace(old_node, node);
+			} else {
+				frontier.push(node);
+			}
 		} else {
-			assert(&nodes.back() == node);
-			nodes.pop_back();
+			si.nodes.release(node);
 			return false;
 		}
 
@@ -100,10 +291,17 @@ bool A_Star::process_node(Search_Info& si, Node* node, const Joint_Action& actio
 
 			// Goal state which DOES satisfy handoff_agent
 		} else if (is_valid_goal(si, node, action)) {
-			si.goal_node = node;
+			evaluate_heuristic(si, node);
+			if (!si.limits.is_anytime() || si.goal_node == nullptr) {
+				si.goal_node = node;
+			} else if (node->is_shorter(si.goal_node)) {
+				si.goal_node = node;
+				++si.stats.improvements;
+			}
 
 			// Non-goal state
 		} else {
+			evaluate_heuristic(si, node);
 			visited.insert(node);
 			frontier.push(node);
 		}
@@ -111,37 +309,57 @@ bool A_Star::process_node(Search_Info& si, Node* node, const Joint_Action& actio
 	return true;
 }
 
-bool A_Star::action_conforms_to_input(const Node* current_node, const std::vector<Joint_Action>& input_actions,
-	const Joint_Action action, const Agent_Combination& free_agents, const Action& initial_action) const {
+bool A_Star::action_conforms_to_input(const Search_Info& si, const Node* current_node, 
+	const Packed_Joint_Action& action, const Action& initial_action) const {
 	if (current_node->g == 0 
 		&& initial_action.has_value()
 		&& action.get_action(initial_action.agent) != initial_action) {
 		return false;
 	}
 
-	size_t input_action_size = input_actions.size();
-
-	if (current_node->g < input_action_size) {
-		auto& action_ref = input_actions.at(current_node->g);
-		//for (size_t action_index = 0; action_index < action_ref.actions.size(); ++action_index) {
-		for (const auto& input_action : action_ref.actions) {
-			//if (!free_agents.contains({ action_index })
-			if (!free_agents.contains(input_action.agent)
-				&& input_action != action.get_action(input_action.agent)) {
-				return false;
-			}
-		}
+	if (current_node->g < si.input_actions.size()) {
+		return action.matches(si.input_actions[current_node->g], si.input_masks[current_node->g]);
 	}
 	return true;
 }
 
-std::vector<Joint_Action> A_Star::extract_actions(const Node* node) const {
+void A_Star::evaluate_heuristic(Search_Info& si, Node* node) const {
+	if (node->h == UNKNOWN_H) {
+		node->h = get_weighted(si, get_heuristic(si, node->state));
+	}
+}
+
+// Node h values are weighted for the frontier order, EMPTY_VAL stays a dead end
+float A_Star::get_weighted(const Search_Info& si, float h) const {
+	return h == EMPTY_VAL ? h : si.limits.weight * h;
+}
+
+// Unweighted f, the cost a plan through the node has at least
+float A_Star::get_lower_bound(const Search_Info& si, const Node* node) const {
+	return node->g + node->h / si.limits.weight;
+}
+
+// States which only differ in what the heuristic ignores share a cache entry
+size_t A_Star::get_heuristic(Search_Info& si, const State& state) const {
+	auto projection = heuristic.get_projection(state);
+	auto it = si.heuristic_cache->find(projection);
+	if (it != si.heuristic_cache->end()) {
+		++si.stats.heuristic_cache_hits;
+		return it->second;
+	}
+	++si.stats.heuristic_calls;
+	auto h = heuristic(state, si.agents, si.handoff_agent);
+	si.heuristic_cache->emplace(projection, h);
+	return h;
+}
+
+std::vector<Joint_Action> A_Star::extract_actions(const Search_Info& si, const Node* node) const {
 	std::vector<Joint_Action> result;
-	while (node->parent != nullptr) {
+	while (node->parent != NO_NODE) {
 		if (node->action.is_action_valid()) {
-			result.push_back(node->action);
+			result.push_back(node->action.to_joint_action());
 		}
-		node = node->parent;
+		node = &si.nodes[node->parent];
 	}
 	std::vector<Joint_Action> reversed;
 	for (auto it = result.rbegin(); it != result.rend(); ++it) {
@@ -150,50 +368,52 @@ std::vector<Joint_Action> A_Star::extract_actions(const Node* node) const {
 	return reversed;
 }
 
-bool A_Star::is_invalid_goal(const Search_Info& si, const Node* node, const Joint_Action& action) const {
+bool A_Star::is_invalid_goal(const Search_Info& si, const Node* node, const Packed_Joint_Action& action) const {
 	return node->state.contains_item(si.recipe.result) 
 		&& si.handoff_agent.is_not_empty() 
 		&& action.is_not_none(si.handoff_agent);
 }
 
-bool A_Star::is_valid_goal(const Search_Info& si, const Node* node, const Joint_Action& action) const {
+bool A_Star::is_valid_goal(const Search_Info& si, const Node* node, const Packed_Joint_Action& action) const {
 	return node->state.contains_item(si.recipe.result)
 		&& (!si.handoff_agent.is_not_empty()
 			|| (node->has_agent_passed() 
 				&& !action.is_not_none(si.handoff_agent)));
 }
 
-Node* A_Star::check_and_perform(Search_Info& si, const Joint_Action& action,
-	const Node* current_node, const std::vector<Joint_Action>& input_actions) const {
-	Node_Ref& nodes = si.nodes;
+Node* A_Star::check_and_perform(Search_Info& si, const Joint_Action& action, const Packed_Joint_Action& packed_action,
+	const Node* current_node) const {
 	auto& handoff_agent = si.handoff_agent;
 	
 	// Useful action from handoff agent after handoff
 	if (current_node->has_agent_passed()
 		&& handoff_agent.is_not_empty()
-		&& action.is_not_none(handoff_agent)) {
+		&& packed_action.is_not_none(handoff_agent)) {
 
 		return nullptr;
 	}
-	nodes.emplace_back(current_node, nodes.size());
-	auto new_node = &nodes.back();
 
-	// Action is illegal or causes no change
-	if (!environment.act(new_node->state, action, Print_Level::NOPE)) {
-		nodes.pop_back();
+	// Action is illegal or causes no change, rejected before a node is allocated
+	State state = current_node->state;
+	if (!environment.act(state, action, Print_Level::NOPE)) {
 		return nullptr;
 	}
 
 	// Action performed
-	new_node->action = action;
+	auto new_node = si.nodes.allocate();
+	new_node->init(current_node);
+	new_node->state = state;
+	new_node->parent = current_node->id;
+	new_node->action = packed_action;
 	new_node->g += 1;
-	new_node->action_count += get_action_cost(action, handoff_agent);
+	new_node->action_count += get_action_cost(packed_action, handoff_agent);
 	new_node->closed = false;
-	new_node->h = heuristic(new_node->state, si.agents, handoff_agent);
+	new_node->h = UNKNOWN_H;
 
-	if (handoff_agent.is_not_empty() && action.get_action(handoff_agent).is_not_none()) {
+	if (handoff_agent.is_not_empty() && packed_action.get_action(handoff_agent).is_not_none()) {
 		new_node->handoff_first_action = std::min(new_node->g, new_node->handoff_first_action);
 		//new_node->pass_time = new_node->g;
+		update_wall_actions(si, current_node, new_node, packed_action);
 	}
 
 	new_node->calculate_hash();
@@ -201,8 +421,40 @@ Node* A_Star::check_and_perform(Search_Info& si, const Joint_Action& action,
 	return new_node;
 }
 
+// Same definitions as the Action_Path constructor. The first interaction is judged on the
+// original state, the last on the state after the action.
+void A_Star::update_wall_actions(const Search_Info& si, const Node* parent, Node* node, 
+	const Packed_Joint_Action& action) const {
+
+	auto direction = action.get_action(si.handoff_agent).direction;
+	auto wall = environment.move_noclip(parent->state.get_location(si.handoff_agent), direction);
+	if (!environment.is_cell_type(wall, Cell_Type::WALL)) {
+		return;
+	}
+	auto action_index = parent->g;
+	if (node->first_wall_action == EMPTY_VAL && is_useful_wall(si, *si.original_state, wall)) {
+		node->first_wall_action = action_index;
+	}
+	if (is_useful_wall(si, node->state, wall)) {
+		node->last_wall_action = action_index;
+	}
+}
+
+// Wall holds an ingredient of the recipe, or the handoff agent does
+bool A_Star::is_useful_wall(const Search_Info& si, const State& state, const Coordinate& wall) const {
+	auto item = state.get_ingredient_at_position(wall);
+	if (item.has_value()
+		&& (item.value() == si.recipe.ingredient1
+			|| item.value() == si.recipe.ingredient2)) {
+		return true;
+	}
+	auto agent_item = state.get_agent(si.handoff_agent).item;
+	return agent_item.has_value()
+		&& (agent_item.value() == si.recipe.ingredient1
+			|| agent_item.value() == si.recipe.ingredient2);
+}
+
 Node* A_Star::generate_handoff(Search_Info& si, Node* node, const std::vector<Joint_Action>& input_actions) const {
-	auto& nodes = si.nodes;
 	Node* pass_node = nullptr;
 	if (si.handoff_agent.is_not_empty() 
 		&& !node->has_agent_passed()) {
@@ -211,16 +463,15 @@ Node* A_Star::generate_handoff(Search_Info& si, Node* node, const std::vector<Jo
 			|| (item.value() != si.recipe.ingredient1
 				&& item.value() != si.recipe.ingredient2)) {
 
-			nodes.emplace_back(node, nodes.size());
-			pass_node = &nodes.back();
-			pass_node->parent = node->parent;
+			pass_node = si.nodes.allocate();
+			pass_node->init(node);
 			pass_node->pass_time = node->g;
 		}
 	}
 	return pass_node;
 }
 
-size_t A_Star::get_action_cost(const Joint_Action& joint_action, const Agent_Id& handoff_agent) const {
+size_t A_Star::get_action_cost(const Packed_Joint_Action& joint_action, const Agent_Id& handoff_agent) const {
 	size_t result = 0;
 	for (size_t agent = 0; agent < joint_action.size(); ++agent) {
 		if (!handoff_agent.is_not_empty() || handoff_agent.id != agent) {
@@ -230,14 +481,29 @@ size_t A_Star::get_action_cost(const Joint_Action& joint_action, const Agent_Id&
 	return result;
 }
 
-Search_Info A_Star::initialize_variables(Recipe& recipe, const State& original_state, const Agent_Id& handoff_agent, const Agent_Combination& agents, const std::vector<Joint_Action>& input_actions) const {
+Search_Info A_Star::initialize_variables(Node_Arena& nodes, Recipe& recipe, const State& original_state, const Agent_Id& handoff_agent, 
+	const Agent_Combination& agents, const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents,
+	Heuristic_Cache& heuristic_cache, const Search_Limits& limits) const {
+
+	nodes.clear();
+	Search_Info si(nodes, recipe, handoff_agent, agents, original_state);
+	si.heuristic_cache = &heuristic_cache;
+	si.depth_limit = std::min(limits.depth_bound, depth_limit);
+	si.limits = limits;
+	if (!limits.is_anytime()) {
+		si.limits.weight = 1.0f;
+	}
 
-	Search_Info si(recipe, handoff_agent, agents);
+	// Packed once, so checking an action against its input is a single compare
+	auto free_fields = Packed_Joint_Action::get_field_mask(free_agents);
+	si.input_actions = pack_joint_actions(input_actions);
+	for (const auto& input_action : si.input_actions) {
+		si.input_masks.push_back(input_action.get_presence_mask() & ~free_fields);
+	}
 
-	constexpr size_t id = 0;
 	constexpr size_t g = 0;
 	constexpr size_t action_count = 0;
-	constexpr Node* parent = nullptr;
+	constexpr Node_Index parent = NO_NODE;
 	constexpr bool closed = false;
 	constexpr bool valid = true;
 	constexpr size_t handoff_first_action = EMPTY_VAL;
@@ -245,14 +511,15 @@ Search_Info A_Star::initialize_variables(Recipe& recipe, const State& original_s
 	bool require_handoff = false;
 	size_t pass_time = EMPTY_VAL;
 	//size_t pass_time = 0;
-	Joint_Action action;
-	size_t h = 0;
-	h = heuristic(original_state, agents, handoff_agent);
+	Packed_Joint_Action action;
+	float h = get_weighted(si, get_heuristic(si, original_state));
+	si.stats.searches = 1;
 	Agent_Id agent;
 
 	// Standard node
-	si.nodes.emplace_back(original_state, id, g, h, action_count, pass_time, can_pass, handoff_first_action, parent, action, closed, valid, agent);
-	auto node = &si.nodes.back();
+	auto node = si.nodes.allocate();
+	*node = Node(original_state, g, h, action_count, pass_time, can_pass, handoff_first_action, parent, action, closed, valid, agent);
+	node->id = 0;
 	node->calculate_hash();
 	si.frontier.push(node);
 	si.visited.insert(node);
@@ -267,8 +534,12 @@ Search_Info A_Star::initialize_variables(Recipe& recipe, const State& original_s
 	return si;
 }
 
-std::vector<Joint_Action> A_Star::get_actions(const Agent_Combination& agents, bool has_handoff_agent) const {
-	return environment.get_joint_actions(agents);
+const Joint_Action_Table& A_Star::get_actions(const Agent_Combination& agents) {
+	auto it = joint_action_tables.find(agents);
+	if (it == joint_action_tables.end()) {
+		it = joint_action_tables.insert({ agents, environment.get_joint_action_table(agents) }).first;
+	}
+	return it->second;
 }
 
 Node* A_Star::get_next_node(Search_Info& si) const {
@@ -276,9 +547,25 @@ Node* A_Star::get_next_node(Search_Info& si) const {
 		auto current_node = si.frontier.top();
 		si.frontier.pop();
 
+		// Goal unreachable, pruning it does not make a failure inexhaustive
+		if (current_node->h == EMPTY_VAL) {
+			current_node->closed = true;
+			++si.stats.dead_ends;
+			continue;
+		}
+
 		// Exceeded depth limit
-		if (current_node->f() >= depth_limit || current_node->h == EMPTY_VAL) {
+		auto lower_bound = get_lower_bound(si, current_node);
+		if (lower_bound >= si.depth_limit) {
+			current_node->closed = true;
+			++si.stats.depth_cutoffs;
+			continue;
+		}
+
+		// Cannot beat the plan an anytime search already has
+		if (si.goal_node != nullptr && lower_bound >= si.goal_node->g) {
 			current_node->closed = true;
+			++si.stats.stale_pops;
 			continue;
 		}
 
@@ -287,27 +574,30 @@ Node* A_Star::get_next_node(Search_Info& si) const {
 			current_node->closed = true;
 			return current_node;
 		}
+		++si.stats.stale_pops;
 	}
 	return nullptr;
 }
 
 void A_Star::print_current(const Node* node) const {
-	if (!is_print_allowed(Print_Level::VERBOSE)) {
+	if (!is_print_allowed(Print_Category::A_STAR, Print_Level::VERBOSE)) {
 		return;
 	}
-	std::cout << "Node " << node->id << ", g=" << node->g << ", Parent " << (node->parent == nullptr ? "-" : std::to_string(node->parent->id)) << ", " << node->action.to_string() << ", pt " << (node->pass_time == EMPTY_VAL ? "X" : std::to_string(node->pass_time)) << ", ";
+	flush_print();
+	std::cout << "Node " << node->id << ", g=" << node->g << ", Parent " << (node->parent == NO_NODE ? "-" : std::to_string(node->parent)) << ", " << node->action.to_string() << ", pt " << (node->pass_time == EMPTY_VAL ? "X" : std::to_string(node->pass_time)) << ", ";
 	node->state.print_compact();
 	std::cout << std::endl;
 }
 
-void A_Star::print_goal(const Node* node) const {
-	if (!is_print_allowed(Print_Level::VERBOSE)) {
+void A_Star::print_goal(const Search_Info& si, const Node* node) const {
+	if (!is_print_allowed(Print_Category::A_STAR, Print_Level::VERBOSE)) {
 		return;
 	}
-	if (node->parent == nullptr) {
+	if (node->parent == NO_NODE) {
+		flush_print();
 		std::cout << "Printing goal" << std::endl;
 	} else {
-		print_goal(node->parent);
+		print_goal(si, &si.nodes[node->parent]);
 	}
 	print_current(node);
 }
\ No newline at end of file
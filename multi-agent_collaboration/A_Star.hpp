@@ -7,39 +7,42 @@
 #include <algorithm>
 #include <queue>
 #include <unordered_set>
+#include <unordered_map>
 #include <memory>
 #include <cassert>
 #include <array>
+#include <map>
+#include <tuple>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
 
 #include "Environment.hpp"
 #include "Search.hpp"
 #include "Utils.hpp"
 #include "Heuristic.hpp"
 
-struct Node {
-	Node() {};
+using Node_Index = uint32_t;
+constexpr Node_Index NO_NODE = UINT32_MAX;
+constexpr uint32_t NOT_QUEUED = UINT32_MAX;
 
-	Node(const Node* other, const size_t& id) {
-		init(other);
-		this->id = id;
-		this->parent = other;
-	}
+// Heuristic not yet evaluated, nodes rejected as duplicates never pay for it
+constexpr float UNKNOWN_H = -1.0f;
 
-	Node(const Node* other) {
-		init(other);
-		this->parent = other;
-	}
+struct Node {
+	Node() {};
 
-	Node(State state, size_t id, size_t g, size_t h, size_t action_count,
+	Node(State state, size_t g, float h, size_t action_count,
 		size_t pass_time, bool can_pass, size_t handoff_first_action,
-		Node* parent, Joint_Action action, bool closed, bool valid, Agent_Id agent)
-		: state(state), id(id), g(g), h(h), action_count(action_count),
-		pass_time(pass_time), can_pass(can_pass), handoff_first_action(handoff_first_action),
-		parent(parent), action(action), closed(closed), valid(valid), agent(agent) {};
+		Node_Index parent, Packed_Joint_Action action, bool closed, bool valid, Agent_Id agent)
+		: g(g), h(h), state(state), action_count(action_count),
+		pass_time(pass_time), can_pass(can_pass), parent(parent), action(action), closed(closed), valid(valid), 
+		handoff_first_action(handoff_first_action), agent(agent), queue_position(NOT_QUEUED),
+		first_wall_action(EMPTY_VAL), last_wall_action(EMPTY_VAL), base(NO_NODE), assigned(0) {};
 	
+	// Copies everything but the id, which belongs to the arena slot
 	void init(const Node* other) {
 		this->state = other->state;
-		this->id = other->id;
 		this->g = other->g;
 		this->h = other->h;
 		this->action_count = other->action_count;
@@ -52,22 +55,36 @@ struct Node {
 		this->handoff_first_action = other->handoff_first_action;
 		this->hash = EMPTY_VAL;
 		this->agent = other->agent;
+		this->queue_position = NOT_QUEUED;
+		this->first_wall_action = other->first_wall_action;
+		this->last_wall_action = other->last_wall_action;
+		this->base = NO_NODE;
+		this->assigned = 0;
 	}
 
 	size_t g;
 	float h;
 	float f() const { return g + h; }
 	State state;
-	size_t id;
+	Node_Index id;
 	size_t action_count;
 	size_t pass_time;
 	bool can_pass;
-	const Node* parent;
-	Joint_Action action;
+	Node_Index parent;
+	Packed_Joint_Action action;
 	bool closed;
 	bool valid;
 	size_t handoff_first_action;
 	Agent_Id agent;
+	uint32_t queue_position;	// Index in the open list heap, NOT_QUEUED when absent
+	size_t first_wall_action;	// Handoff_Actions of the path to this node
+	size_t last_wall_action;
+	Node_Index base;			// Node an intermediate node expands, NO_NODE for full nodes
+	size_t assigned;			// Goal agents with an action in an intermediate node
+
+	bool is_intermediate() const {
+		return base != NO_NODE;
+	}
 
 	// For debug purposes
 	size_t hash;
@@ -82,8 +99,8 @@ struct Node {
 	}
 
 	size_t to_hash() const {
-		std::string pass_string = (pass_time == EMPTY_VAL ? "0" : "1");
-		return std::hash<std::string>()(state.to_hash_string() + pass_string);
+		static constexpr uint64_t pass_key = State::zobrist_key(3ull << 32);
+		return state.to_hash() ^ (has_agent_passed() ? pass_key : 0);
 	}
 
 	bool has_agent_passed() const {
@@ -91,6 +108,7 @@ struct Node {
 	}
 
 	bool operator<(const Node* other) const {
+		flush_print();
 		std::cout << "<node" << std::endl;
 		return this->state < other->state;
 	}
@@ -146,7 +164,7 @@ struct Node_Queue_Comparator {
 };
 
 struct Node_Hasher {
-	bool operator()(const Node* node) const {
+	size_t operator()(const Node* node) const {
 		return node->to_hash();
 	}
 };
@@ -157,25 +175,158 @@ struct Node_Set_Comparator {
 	}
 };
 
-using Node_Queue = std::priority_queue<Node*, std::vector<Node*>, Node_Queue_Comparator>;
+// Binary heap of open nodes ordered by Node_Queue_Comparator. Each node knows its
+// heap position, so a shorter path to a queued state replaces the queued node in
+// place instead of leaving a stale duplicate behind.
+class Node_Queue {
+public:
+	bool empty() const { return heap.empty(); }
+	size_t size() const { return heap.size(); }
+	Node* top() const { return heap.front(); }
+
+	void push(Node* node) {
+		heap.push_back(node);
+		sift_up(heap.size() - 1);
+	}
+
+	void pop() {
+		heap.front()->queue_position = NOT_QUEUED;
+		heap.front() = heap.back();
+		heap.pop_back();
+		if (!heap.empty()) {
+			sift_down(0);
+		}
+	}
+
+	bool contains(const Node* node) const {
+		return node->queue_position != NOT_QUEUED;
+	}
+
+	// Decrease-key, replacement must not have lower priority than the queued node
+	void replace(Node* queued, Node* replacement) {
+		assert(contains(queued));
+		auto position = queued->queue_position;
+		queued->queue_position = NOT_QUEUED;
+		heap[position] = replacement;
+		sift_up(position);
+	}
+
+private:
+	void place(size_t position, Node* node) {
+		heap[position] = node;
+		node->queue_position = static_cast<uint32_t>(position);
+	}
+
+	void sift_up(size_t position) {
+		Node* node = heap[position];
+		while (position > 0) {
+			size_t parent = (position - 1) / 2;
+			if (!comparator(heap[parent], node)) break;
+			place(position, heap[parent]);
+			position = parent;
+		}
+		place(position, node);
+	}
+
+	// Bottom-up: walk the hole down to a leaf along the preferred children, then
+	// sift the node back up. Matches the tie order of std::pop_heap.
+	void sift_down(size_t position) {
+		Node* node = heap[position];
+		size_t size = heap.size();
+		size_t child = 2 * position + 2;
+		while (child < size) {
+			if (comparator(heap[child], heap[child - 1])) --child;
+			place(position, heap[child]);
+			position = child;
+			child = 2 * position + 2;
+		}
+		if (child == size) {
+			place(position, heap[child - 1]);
+			position = child - 1;
+		}
+		heap[position] = node;
+		sift_up(position);
+	}
+
+	std::vector<Node*> heap;
+	Node_Queue_Comparator comparator;
+};
 using Node_Set = std::unordered_set<Node*, Node_Hasher, Node_Set_Comparator>;
-using Node_Ref = std::deque<Node>;
+
+// Slab allocator for search nodes. Blocks are never freed, so node pointers stay
+// valid for the whole search, and clear() lets the next search reuse the slots.
+class Node_Arena {
+public:
+	Node* allocate() {
+		if (count == blocks.size() * BLOCK_SIZE) {
+			blocks.push_back(std::make_unique<Node[]>(BLOCK_SIZE));
+		}
+		auto node = &(*this)[static_cast<Node_Index>(count)];
+		node->id = static_cast<Node_Index>(count);
+		++count;
+		return node;
+	}
+
+	// Only valid for the most recently allocated node
+	void release(const Node* node) {
+		if (node->id + 1 != count) {
+			throw std::runtime_error("Released node " + std::to_string(node->id) + " is not the last allocated");
+		}
+		--count;
+	}
+
+	void clear() { count = 0; }
+	size_t size() const { return count; }
+
+	Node& operator[](Node_Index index) { return blocks[index >> BLOCK_BITS][index & (BLOCK_SIZE - 1)]; }
+	const Node& operator[](Node_Index index) const { return blocks[index >> BLOCK_BITS][index & (BLOCK_SIZE - 1)]; }
+
+private:
+	static constexpr size_t BLOCK_BITS = 12;
+	static constexpr size_t BLOCK_SIZE = 1 << BLOCK_BITS;
+	std::vector<std::unique_ptr<Node[]>> blocks;
+	size_t count = 0;
+};
+
+// Heuristic values by Heuristic::get_projection of the state
+using Heuristic_Cache = std::unordered_map<State, size_t>;
+
+// How A_Star generates the successors of a node
+enum class Joint_Expansion {
+	FULL,					// Every joint action at once, 5^k successors for k agents
+	OPERATOR_DECOMPOSITION	// One agent's action per intermediate node, in agent order
+};
+
+// How long A_Star keeps heuristic values
+enum class Heuristic_Cache_Scope {
+	SEARCH,		// Cleared at the start of every search
+	GOAL		// Kept across searches with the same recipe, agents and handoff agent
+};
 
 struct Search_Info {
-	Search_Info(const Recipe& recipe, const Agent_Id& handoff_agent, const Agent_Combination& agents)
-		: frontier(), visited(), nodes(), goal_node(nullptr), recipe(recipe), 
-		handoff_agent(handoff_agent), agents(agents) {}
+	Search_Info(Node_Arena& nodes, const Recipe& recipe, const Agent_Id& handoff_agent, const Agent_Combination& agents,
+		const State& original_state)
+		: frontier(), visited(), nodes(nodes), goal_node(nullptr), recipe(recipe), 
+		handoff_agent(handoff_agent), agents(agents), input_actions(), input_masks(), original_state(&original_state), 
+		heuristic_cache(nullptr), depth_limit(EMPTY_VAL), limits(), stats() {}
 	bool has_goal_node() const {
 		return goal_node != nullptr;
 	}
 
 	Node_Queue frontier;
 	Node_Set visited;
-	Node_Ref nodes;
+	Node_Arena& nodes;
 	Node* goal_node;
 	Recipe recipe;
 	Agent_Id handoff_agent;
 	Agent_Combination agents;
+	std::vector<Packed_Joint_Action> input_actions;
+	std::vector<uint32_t> input_masks;	// Fields of input_actions fixed for the search, agents not in free_agents
+	const State* original_state;
+	Heuristic_Cache* heuristic_cache;
+	size_t depth_limit;		// depth_limit of the search, or a tighter per-search bound
+	Search_Limits limits;
+	Search_Stats stats;
 };
 
 class Manhattan_Heuristic {
@@ -222,31 +373,56 @@ public:
 
 class A_Star : public Search_Method {
 public:
-	A_Star(const Environment& environment, size_t depth_limit);
+	A_Star(const Environment& environment, size_t depth_limit, 
+		Heuristic_Cache_Scope heuristic_cache_scope = Heuristic_Cache_Scope::SEARCH,
+		Joint_Expansion joint_expansion = Joint_Expansion::FULL);
 	std::vector<Joint_Action> search_joint(const State& state, Recipe recipe, 
 		const Agent_Combination& agents, Agent_Id handoff_agent,
 		const std::vector<Joint_Action>& input_actions, 
-		const Agent_Combination& free_agents, const Action& initial_action = {}) override;
+		const Agent_Combination& free_agents, const Action& initial_action = {},
+		Search_Stats* stats = nullptr, Handoff_Actions* handoff_actions = nullptr, const Search_Limits& limits = {}) override;
 	std::pair<size_t, Direction> get_dist_direction(Coordinate source, Coordinate dest, size_t walls) override;
 private:
 	
 	
 	
-	bool						action_conforms_to_input(const Node* current_node, const std::vector<Joint_Action>& input_actions,
-									const Joint_Action action, const Agent_Combination& agents, const Action& initial_action) const;
-	Node*						check_and_perform(Search_Info& si, const Joint_Action& action, const Node* current_node, const std::vector<Joint_Action>& input_actions) const;
-	std::vector<Joint_Action>	extract_actions(const Node* node) const;
+	bool						action_conforms_to_input(const Search_Info& si, const Node* current_node, 
+									const Packed_Joint_Action& action, const Action& initial_action) const;
+	Node*						check_and_perform(Search_Info& si, const Joint_Action& action, const Packed_Joint_Action& packed_action, 
+									const Node* current_node) const;
+	void						evaluate_heuristic(Search_Info& si, Node* node) const;
+	void						add_successor(Search_Info& si, Node* node, const Packed_Joint_Action& action, 
+									const std::vector<Joint_Action>& input_actions) const;
+	bool						agent_action_allowed(const Search_Info& si, const Node* base, 
+									const Packed_Joint_Action& partial_action, const Action& action, 
+									const Action& initial_action) const;
+	void						expand_decomposed(Search_Info& si, Node* node, const std::vector<Joint_Action>& input_actions,
+									const Action& initial_action) const;
+	void						expand_full(Search_Info& si, Node* node, const Joint_Action_Table& actions, 
+									const std::vector<Joint_Action>& input_actions, const Action& initial_action, 
+									std::vector<bool>& collides) const;
+	std::vector<Joint_Action>	extract_actions(const Search_Info& si, const Node* node) const;
 	Node*						generate_handoff(Search_Info& si, Node* node, const std::vector<Joint_Action>& input_actions) const;
-	size_t						get_action_cost(const Joint_Action& action, const Agent_Id& handoff_agent) const;
-	std::vector<Joint_Action>	get_actions(const Agent_Combination& agents, bool has_handoff_agent) const;
+	size_t						get_action_cost(const Packed_Joint_Action& action, const Agent_Id& handoff_agent) const;
+	const Joint_Action_Table&	get_actions(const Agent_Combination& agents);
+	size_t						get_heuristic(Search_Info& si, const State& state) const;
+	Heuristic_Cache&			get_heuristic_cache(const Recipe& recipe, const Agent_Combination& agents, 
+									const Agent_Id& handoff_agent);
+	float						get_lower_bound(const Search_Info& si, const Node* node) const;
 	Node*						get_next_node(Search_Info& si) const;
-	Search_Info					initialize_variables(Recipe& recipe, const State& original_state, 
-									const Agent_Id& handoff_agent, const Agent_Combination& agents, const std::vector<Joint_Action>& input_actions) const;
-	bool						is_invalid_goal(const Search_Info& si, const Node* node, const Joint_Action& action) const;
-	bool						is_valid_goal(const Search_Info& si, const Node* node, const Joint_Action& action) const;
+	float						get_weighted(const Search_Info& si, float h) const;
+	Search_Info					initialize_variables(Node_Arena& nodes, Recipe& recipe, const State& original_state, 
+									const Agent_Id& handoff_agent, const Agent_Combination& agents, const std::vector<Joint_Action>& input_actions,
+									const Agent_Combination& free_agents, Heuristic_Cache& heuristic_cache, 
+									const Search_Limits& limits) const;
+	bool						is_useful_wall(const Search_Info& si, const State& state, const Coordinate& wall) const;
+	bool						is_invalid_goal(const Search_Info& si, const Node* node, const Packed_Joint_Action& action) const;
+	bool						is_valid_goal(const Search_Info& si, const Node* node, const Packed_Joint_Action& action) const;
 	void						print_current(const Node* node) const;
-	void						print_goal(const Node* node) const;
-	bool						process_node(Search_Info& si, Node* node, const Joint_Action& action) const;
+	void						print_goal(const Search_Info& si, const Node* node) const;
+	bool						process_node(Search_Info& si, Node* node, const Packed_Joint_Action& action) const;
+	void						update_wall_actions(const Search_Info& si, const Node* parent, Node* node, 
+									const Packed_Joint_Action& action) const;
 
 	
 	
@@ -257,4 +433,10 @@ private:
 
 	Heuristic dist_heuristic; 
 	Heuristic heuristic;
+	Node_Arena nodes;
+	std::map<Agent_Combination, Joint_Action_Table> joint_action_tables;
+	Heuristic_Cache_Scope heuristic_cache_scope;
+	Joint_Expansion joint_expansion;
+	Heuristic_Cache search_heuristic_cache;
+	std::map<std::tuple<Recipe, Agent_Combination, Agent_Id>, Heuristic_Cache> goal_heuristic_caches;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "BFS.hpp"
 #include "Search.hpp"
 
+#include <chrono>
 #include <unordered_set>
 #include <queue>
 #include <iostream>
@@ -8,12 +9,18 @@
 
 std::vector<Joint_Action> BFS::search_joint(const State& state,
 	Recipe recipe, const Agent_Combination& agents, Agent_Id handoff_agent,
-	const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents, const Action& initial_action) {
+	const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents, const Action& initial_action,
+	Search_Stats* stats, Handoff_Actions* handoff_actions, const Search_Limits& /*limits*/) {
 
 	if (handoff_agent.is_not_empty()) {
 		throw std::runtime_error("Handoff agent not supported for bfs");
 	}
 
+	// Without a handoff agent there are no handoff interactions
+	if (handoff_actions != nullptr) {
+		*handoff_actions = Handoff_Actions(EMPTY_VAL, EMPTY_VAL);
+	}
+
 	if (initial_action.has_value()) {
 		throw std::runtime_error("Initial action not supported for bfs");
 	}
@@ -29,20 +36,39 @@ std::vector<Joint_Action> BFS::search_joint(const State& state,
 	size_t state_id = 1;
 	size_t goal_id = 0;
 
+	auto time_start = std::chrono::steady_clock::now();
+	Search_Stats search_stats;
+	search_stats.searches = 1;
+	auto finish_stats = [&]() {
+		search_stats.peak_visited = visited.size();
+		search_stats.time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - time_start).count();
+		if (stats != nullptr) {
+			*stats = search_stats;
+		}
+	};
+
 	auto actions = environment.get_joint_actions(agents);
 	while (!done) {
+		search_stats.peak_frontier = std::max(search_stats.peak_frontier, frontier.size());
+
 		// No possible path
 		if (frontier.empty()) {
+			finish_stats();
 			return {};
 		}
 		auto current_state = frontier.front();
 		frontier.pop_front();
+		++search_stats.expanded;
 
 		for (const auto& action : actions) {
 			auto temp_state = current_state;
 			environment.act(temp_state.state, action, Print_Level::NOPE);
 			auto search_state = Search_Joint_State(temp_state.state, action, current_state.id, state_id);
-			if (visited.find(search_state) == visited.end()) {
+			++search_stats.generated;
+			if (visited.find(search_state) != visited.end()) {
+				++search_stats.duplicates_merged;
+			} else {
 				visited.insert(search_state);
 				path.push_back(search_state);
 				frontier.push_back(search_state);
@@ -55,6 +81,7 @@ std::vector<Joint_Action> BFS::search_joint(const State& state,
 			}
 		}
 	}
+	finish_stats();
 	return extract_actions<Search_Joint_State>(goal_id, path);
 }
 
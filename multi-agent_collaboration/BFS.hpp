@@ -12,7 +12,8 @@ public:
 		Recipe recipe, const Agent_Combination& agents, 
 		Agent_Id handoff_agent,
 		const std::vector<Joint_Action>& input_actions, 
-		const Agent_Combination& free_agents, const Action& initial_action) override;
+		const Agent_Combination& free_agents, const Action& initial_action,
+		Search_Stats* stats = nullptr, Handoff_Actions* handoff_actions = nullptr, const Search_Limits& limits = {}) override;
 	std::pair<size_t, Direction> get_dist_direction(Coordinate source, Coordinate dest, size_t walls) override;
 private:
 };
\ No newline at end of file
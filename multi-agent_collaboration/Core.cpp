@@ -1,56 +1,222 @@
 #include "Core.hpp"
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <thread>
 
+constexpr size_t LOG_RING_CAPACITY = 4096;			// Messages, power of two
+constexpr size_t LOG_MAX_SIZE = 64 * 1024 * 1024;	// Bytes kept for flush_log
 
-static bool save_to_log = false;
-static std::stringstream buffer;
+/**
+Bounded multi-producer ring of messages drained by one background writer.
+Producers claim a slot with a single compare-and-swap and never block, when
+the ring is full the message is dropped and counted instead. The writer sleeps
+until a message arrives, producers only take its mutex to wake it. Draining is
+serialised by a mutex so flush_print and flush_log can drain from any thread.
+*/
+class Log_Sink {
+public:
+	Log_Sink() : enqueue_position(0), dequeue_position(0), dropped(0),
+		stopping(false), pending(false), writer_waiting(false), save_to_log(false), log_truncated(false) {
+		for (size_t i = 0; i < LOG_RING_CAPACITY; ++i) {
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	~Log_Sink() {
+		stopping.store(true);
+		wake_writer();
+		if (writer.joinable()) {
+			writer.join();
+		}
+		std::lock_guard<std::mutex> lock(consumer_mutex);
+		drain();
+	}
+
+	void push(std::string message) {
+		std::call_once(writer_started, [this]() {
+			writer = std::thread(&Log_Sink::writer_loop, this);
+		});
+
+		auto position = enqueue_position.load(std::memory_order_relaxed);
+		Slot* slot;
+		while (true) {
+			slot = &slots[position & (LOG_RING_CAPACITY - 1)];
+			auto sequence = slot->sequence.load(std::memory_order_acquire);
+			auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+			if (difference == 0) {
+				if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (difference < 0) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			} else {
+				position = enqueue_position.load(std::memory_order_relaxed);
+			}
+		}
+		slot->message = std::move(message);
+		slot->sequence.store(position + 1, std::memory_order_release);
+
+		// Pairs with the writer storing writer_waiting before it tests pending, so one of them sees the other
+		pending.store(true);
+		if (writer_waiting.load()) {
+			wake_writer();
+		}
+	}
+
+	void flush() {
+		std::lock_guard<std::mutex> lock(consumer_mutex);
+		drain();
+	}
+
+	void enable_log() {
+		std::lock_guard<std::mutex> lock(consumer_mutex);
+		drain();
+		save_to_log = true;
+		log.clear();
+		log_truncated = false;
+	}
+
+	std::string take_log() {
+		std::lock_guard<std::mutex> lock(consumer_mutex);
+		drain();
+		std::string result;
+		result.swap(log);
+		log_truncated = false;
+		return result;
+	}
+
+private:
+	struct Slot {
+		std::atomic<size_t> sequence;
+		std::string message;
+	};
+
+	// Requires consumer_mutex
+	bool drain() {
+		std::string batch;
+		while (true) {
+			auto& slot = slots[dequeue_position & (LOG_RING_CAPACITY - 1)];
+			if (slot.sequence.load(std::memory_order_acquire) != dequeue_position + 1) {
+				break;
+			}
+			batch += slot.message;
+			slot.message.clear();
+			slot.sequence.store(dequeue_position + LOG_RING_CAPACITY, std::memory_order_release);
+			++dequeue_position;
+		}
+		auto dropped_count = dropped.exchange(0, std::memory_order_relaxed);
+		if (dropped_count > 0) {
+			batch += "[" + std::to_string(dropped_count) + " log messages dropped]\n";
+		}
+		if (batch.empty()) {
+			return false;
+		}
+
+		if (!save_to_log) {
+			std::cout << batch << std::flush;
+		} else if (log.size() + batch.size() <= LOG_MAX_SIZE) {
+			log += batch;
+		} else if (!log_truncated) {
+			log += "[log truncated]\n";
+			log_truncated = true;
+		}
+		return true;
+	}
+
+	void wake_writer() {
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex);
+		}
+		wake.notify_one();
+	}
+
+	void writer_loop() {
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(wake_mutex);
+				writer_waiting.store(true);
+				wake.wait(lock, [this]() { return pending.load() || stopping.load(); });
+				writer_waiting.store(false);
+			}
+			if (stopping.load()) {
+				break;
+			}
+
+			// Messages pushed after the exchange set pending again
+			pending.exchange(false);
+			std::lock_guard<std::mutex> lock(consumer_mutex);
+			drain();
+		}
+	}
+
+	std::array<Slot, LOG_RING_CAPACITY> slots;
+	std::atomic<size_t> enqueue_position;
+	size_t dequeue_position;		// Guarded by consumer_mutex
+	std::atomic<size_t> dropped;
+	std::mutex consumer_mutex;
+	std::once_flag writer_started;
+	std::thread writer;
+	std::atomic<bool> stopping;
+	std::atomic<bool> pending;		// Messages pushed since the writer last drained
+	std::atomic<bool> writer_waiting;
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	bool save_to_log;				// Guarded by consumer_mutex
+	bool log_truncated;
+	std::string log;
+};
+
+static Log_Sink& get_sink() {
+	static Log_Sink sink;
+	return sink;
+}
+
+static std::atomic<uint32_t> print_categories(0xFFFFFFFFu);
+
+uint32_t get_print_categories() {
+	return print_categories.load(std::memory_order_relaxed);
+}
+
+void set_print_categories(uint32_t categories) {
+	print_categories.store(categories, std::memory_order_relaxed);
+}
+
+void flush_print() {
+	get_sink().flush();
+}
 
 void set_logging_enabled() {
-	save_to_log = true;
-	buffer.str(std::string());
+	get_sink().enable_log();
 }
 
 void flush_log(const std::string& file_name) {
 	std::ofstream file;
 	file.open(file_name);
-	file << buffer.str();
+	file << get_sink().take_log();
 	file.close();
-	buffer.str(std::string());
-}
-
-bool is_print_allowed(Print_Level level) {
-	return PRINT_LEVEL <= level;
 }
 
 void print(Print_Level level, const std::string& msg) {
 	if (level == PRINT_LEVEL) {
-		if (save_to_log) {
-			buffer << msg;
-		} else {
-			std::cout << msg << std::endl;
-		}
+		get_sink().push(msg + '\n');
 	}
 }
 
 void print(Print_Category category, const std::string& msg) {
-	if (static_cast<size_t>(category) == 1 && PRINT_LEVEL == Print_Level::DEBUG) {
-		if (save_to_log) {
-			buffer << msg;
-		} else {
-			std::cout << msg;
-		}
+	if (is_print_allowed(category, Print_Level::DEBUG) && PRINT_LEVEL == Print_Level::DEBUG) {
+		get_sink().push(msg);
 	}
 }
 
-void print(Print_Category category, Print_Level level, const std::string& msg) {
-	if (static_cast<size_t>(category) == 1 && is_print_allowed(level)) {
-		if (save_to_log) {
-			buffer << msg;
-		} else {
-			std::cout << msg;
-		}
+void print(Print_Category category, Print_Level level, std::string msg) {
+	if (is_print_allowed(category, level)) {
+		get_sink().push(std::move(msg));
 	}
-}
\ No newline at end of file
+}
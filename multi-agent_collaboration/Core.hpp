@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string>
 
 enum class Print_Level {
@@ -8,28 +9,60 @@ enum class Print_Level {
 	INFO
 };
 
-enum class Print_Category {
-	STATE=1,
-	A_STAR=1,
-	PLANNER=1,
-	ENVIRONMENT=1,
-	RECOGNISER=1,
-	UTILS=1,
+// Bit masks, combine with | in PRINT_CATEGORIES or set_print_categories
+enum class Print_Category : uint32_t {
+	STATE=1<<0,
+	A_STAR=1<<1,
+	PLANNER=1<<2,
+	ENVIRONMENT=1<<3,
+	RECOGNISER=1<<4,
+	UTILS=1<<5,
 };
 
 #ifndef PRINT_LEVEL
 #define PRINT_LEVEL Print_Level::INFO
 #endif
 
-bool is_print_allowed(Print_Level level);
+// Categories compiled in, the rest are removed by the compiler
+#ifndef PRINT_CATEGORIES
+#define PRINT_CATEGORIES 0xFFFFFFFFu
+#endif
+
+constexpr bool is_print_allowed(Print_Level level) {
+	return PRINT_LEVEL <= level;
+}
+
+constexpr bool is_print_compiled(Print_Category category) {
+	return (PRINT_CATEGORIES & static_cast<uint32_t>(category)) != 0;
+}
+
+// Categories enabled at runtime, all by default
+uint32_t get_print_categories();
+void set_print_categories(uint32_t categories);
+
+inline bool is_print_allowed(Print_Category category, Print_Level level) {
+	return is_print_allowed(level)
+		&& is_print_compiled(category)
+		&& (get_print_categories() & static_cast<uint32_t>(category)) != 0;
+}
+
 void print(Print_Level level, const std::string& msg);
 void print(Print_Category category, const std::string& msg);
-void print(Print_Category category, Print_Level level, const std::string& msg);
+void print(Print_Category category, Print_Level level, std::string msg);
+
+// Writes out everything printed so far before returning
+void flush_print();
 
 void set_logging_enabled();
 void flush_log(const std::string& file_name);
 
-#define PRINT(category, level, msg) print(category, level, msg)
+// msg is only evaluated when the category and level are enabled
+#define PRINT(category, level, msg) \
+	do { \
+		if (is_print_allowed(category, level)) { \
+			print(category, level, msg); \
+		} \
+	} while (false)
 
 #define EMPTY_VAL 9999
 #define HIGH_INIT_VAL 99999
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <set>
 #include <sstream>
 #include <stdlib.h>
+#include <array>
 
 #include "State.hpp"
 
@@ -115,29 +116,49 @@ bool Environment::act(State& state, const Joint_Action& action) const {
 // Had to do this method pretty weird, since BD have pretty weird rules
 // Any action related to counters (pickup, put down, merge, deliver) is valied as long as it was valid in the original state
 // Any action which causes an inter-agent collision is invalid no matter if it was valid in the original state
+// All actions are validated against the unmodified state first, then applied in agent order, so no copy is needed
 bool Environment::act(State& state, const Joint_Action& joint_action, Print_Level print_level) const {
 	if (contains_collisions(state, joint_action)) {
 		return false;
 	}
-	const State original_state = state;
-	bool first = true;
 	for (const auto& action : joint_action.actions) {
-		if (first) {
-			first = false;
-			if (!act(state, action, print_level)) {
-				return false;
-			}
-		} else {
-			State state_copy = original_state;
-			if (!act(state_copy, action, print_level)) {
-				return false;
-			}
-			act(state, action, print_level);
+		if (!is_action_valid(state, action)) {
+			return false;
 		}
 	}
+	for (const auto& action : joint_action.actions) {
+		act(state, action, print_level);
+	}
 	return true;
 }
 
+// Mirrors the branches of act(State&, const Action&, Print_Level) without modifying the state
+bool Environment::is_action_valid(const State& state, const Action& action) const {
+	if (action.direction == Direction::NONE) {
+		return true;
+	}
+
+	Coordinate new_position = move_noclip(state.get_location(action.agent), action.direction);
+
+	// Simple move, delivery station is always allowed
+	if (!is_cell_type(new_position, Cell_Type::WALL)
+		|| is_cell_type(new_position, Cell_Type::DELIVERY_STATION)) {
+		return true;
+	}
+
+	auto item_old_position = state.get_agent_item(action.agent);
+	auto item_new_position = state.get_ingredient_at_position(new_position);
+
+	// Combine
+	if (item_new_position.has_value() && item_old_position.has_value()) {
+		return get_recipe(item_old_position.value(), item_new_position.value()).has_value()
+			|| get_recipe(item_new_position.value(), item_old_position.value()).has_value();
+	}
+
+	// Chop, place or pickup
+	return item_old_position.has_value() || item_new_position.has_value();
+}
+
 bool Environment::act(State& state, const Action& action) const {
 	return act(state, action, Print_Level::VERBOSE);
 }
@@ -147,16 +168,16 @@ bool Environment::act(State& state, const Action& action, Print_Level print_leve
 		return true;
 	}
 
-	auto& agent = state.agents.at(action.agent.id);
-	Coordinate old_position = agent.coordinate;
+	const auto& agent = action.agent;
+	Coordinate old_position = state.get_location(agent);
 	Coordinate new_position = move_noclip(old_position, action.direction);	
 
-	auto item_old_position = agent.item;
+	auto item_old_position = state.get_agent_item(agent);
 	auto item_new_position = state.get_ingredient_at_position(new_position);
 
 	// Simple move
 	if (!is_cell_type(new_position, Cell_Type::WALL)) {
-		state.agents.at(action.agent.id).move_to(new_position);
+		state.move_agent(agent, new_position);
 		PRINT(Print_Category::ENVIRONMENT, print_level, std::string("Moved ") + static_cast<char>(action.direction) + "\n");
 		return true;
 
@@ -165,7 +186,7 @@ bool Environment::act(State& state, const Action& action, Print_Level print_leve
 		if (item_old_position.has_value()) {
 			auto recipe = get_recipe(Ingredient::DELIVERY, item_old_position.value());
 			if (recipe.has_value()) {
-				agent.clear_item();
+				state.clear_agent_item(agent);
 				state.add_goal_item(new_position, recipe.value());
 				PRINT(Print_Category::ENVIRONMENT, print_level, std::string("goal ingredient delivered ") + static_cast<char>(recipe.value()) + "\n");
 				return true;
@@ -179,16 +200,14 @@ bool Environment::act(State& state, const Action& action, Print_Level print_leve
 		auto recipe = get_recipe(item_old_position.value(), item_new_position.value());
 		if (recipe.has_value()) {
 			state.remove(new_position);
-			agent.clear_item();
-			agent.set_item(recipe.value());
+			state.set_agent_item(agent, recipe.value());
 			PRINT(Print_Category::ENVIRONMENT, print_level, std::string("Combine ") + static_cast<char>(recipe.value()) + "\n");
 			return true;
 		} else {
 			auto recipe_reverse = get_recipe(item_new_position.value(), item_old_position.value());
 			if (recipe_reverse.has_value()) {
 				state.remove(new_position);
-				agent.clear_item();
-				agent.set_item(recipe_reverse.value());
+				state.set_agent_item(agent, recipe_reverse.value());
 				PRINT(Print_Category::ENVIRONMENT, print_level, std::string("Combine ") + static_cast<char>(recipe_reverse.value()) + "\n");
 				return true;
 			}
@@ -198,12 +217,11 @@ bool Environment::act(State& state, const Action& action, Print_Level print_leve
 	} else if (is_cell_type(new_position, Cell_Type::CUTTING_STATION) && !item_new_position.has_value() && item_old_position.has_value()) {
 		auto recipe = get_recipe(Ingredient::CUTTING, item_old_position.value());
 		if (recipe.has_value()) {
-			agent.clear_item();
-			agent.set_item(recipe.value());
+			state.set_agent_item(agent, recipe.value());
 			PRINT(Print_Category::ENVIRONMENT, print_level, std::string("chop chop ") + static_cast<char>(recipe.value()) + "\n");
 			return true;
 		} else {
-			agent.clear_item();
+			state.clear_agent_item(agent);
 			state.add(new_position, item_old_position.value());
 			PRINT(Print_Category::ENVIRONMENT, print_level, std::string("pickup") + "\n");
 			return true;
@@ -212,7 +230,7 @@ bool Environment::act(State& state, const Action& action, Print_Level print_leve
 
 	// Place
 	} else if (item_old_position.has_value()) {
-		agent.clear_item();
+		state.clear_agent_item(agent);
 		state.add(new_position, item_old_position.value());
 		PRINT(Print_Category::ENVIRONMENT, print_level, std::string("place ") + static_cast<char>(item_old_position.value()) + "\n");
 		return true;
@@ -220,7 +238,7 @@ bool Environment::act(State& state, const Action& action, Print_Level print_leve
 	// Pickup
 	} else if (item_new_position.has_value()) {
 		state.remove(new_position);
-		agent.set_item(item_new_position.value());
+		state.set_agent_item(agent, item_new_position.value());
 		PRINT(Print_Category::ENVIRONMENT, print_level, std::string("pickup ") + static_cast<char>(item_new_position.value()) + "\n");
 		return true;
 	}
@@ -233,41 +251,30 @@ bool Environment::act(State& state, const Action& action, Print_Level print_leve
 // UPDATE: the original code did allow collision with stationary agents, changed it to disallow this even though I believe that BD allows it
 // To clarify, it seem the BD environment is over liberal with what it allows, the real restrictions in what actions the BD planner considers legal
 bool Environment::contains_collisions(const State& state, const Joint_Action& joint_action) const {
-	std::vector<Coordinate> current_coordinates;
-	std::vector<Coordinate> next_coordinates;
-	std::vector<Coordinate> action_coordinates;
+	assert(joint_action.actions.size() <= STATE_MAX_AGENTS);
+	std::array<Coordinate, STATE_MAX_AGENTS> current_coordinates;
+	std::array<Coordinate, STATE_MAX_AGENTS> next_coordinates;
 
-	std::set<size_t> cancelled_agents;
-	
 	for (size_t agent = 0; agent < joint_action.actions.size(); ++agent) {
-		current_coordinates.push_back(state.agents.at(agent).coordinate);
-		next_coordinates.push_back(move(state.agents.at(agent).coordinate, joint_action.actions.at(agent).direction));
-		action_coordinates.push_back(move_noclip(state.agents.at(agent).coordinate, joint_action.actions.at(agent).direction));
+		auto coordinate = state.get_location(agent);
+		current_coordinates[agent] = coordinate;
+		next_coordinates[agent] = move(coordinate, joint_action.actions[agent].direction);
 	}
 
 	for (size_t agent1 = 0; agent1 < joint_action.actions.size(); ++agent1) {
 		for (size_t agent2 = agent1+1; agent2 < joint_action.actions.size(); ++agent2) {
-			if (next_coordinates.at(agent1) == next_coordinates.at(agent2)) {
-				
-				// Agent1 still, agent2 invalid
-				if (current_coordinates.at(agent1) == next_coordinates.at(agent1)) {//&& joint_action.actions.at(agent1).direction != Direction::NONE) {
-					cancelled_agents.insert(agent2);
-
-				// Agent2 still, agent1 invalid
-				} else if (current_coordinates.at(agent2) == next_coordinates.at(agent2)){// && joint_action.actions.at(agent2).direction != Direction::NONE) {
-					cancelled_agents.insert(agent1);
-				} else {
-					cancelled_agents.insert(agent1);
-					cancelled_agents.insert(agent2);
-				}
+
+			// Same destination, whether or not one of them stands still
+			if (next_coordinates[agent1] == next_coordinates[agent2]) {
+				return true;
+			}
+
 			// Swap (invalid)
-			} else if (current_coordinates.at(agent1) == next_coordinates.at(agent2) 
-				|| current_coordinates.at(agent2) == next_coordinates.at(agent1)) {
-				cancelled_agents.insert(agent1);
-				cancelled_agents.insert(agent2);
+			if (current_coordinates[agent1] == next_coordinates[agent2]
+				|| current_coordinates[agent2] == next_coordinates[agent1]) {
+				return true;
+			}
 
-			} 
-			
 			// Accessing same counter space
 			//else if (action_coordinates.at(agent1) == action_coordinates.at(agent2)) {
 			//	cancelled_agents.insert(agent1);
@@ -275,16 +282,55 @@ bool Environment::contains_collisions(const State& state, const Joint_Action& jo
 			//}
 		}
 	}
-	return !cancelled_agents.empty();
-	//for (const auto& agent : cancelled_agents) {
-	//	joint_action.actions.at(agent).direction = Direction::NONE;
-	//}
+	return false;
 }
 
 std::vector<Action> Environment::get_actions(Agent_Id agent) const {
 	return { {Direction::UP, agent}, {Direction::RIGHT, agent}, {Direction::DOWN, agent}, {Direction::LEFT, agent}, {Direction::NONE, agent} };
 }
 
+Joint_Action_Table Environment::get_joint_action_table(const Agent_Combination& agents) const {
+	assert(number_of_agents <= Packed_Joint_Action::MAX_AGENTS);
+	Joint_Action_Table table;
+	table.joint_actions = get_joint_actions(agents);
+	table.packed_actions = pack_joint_actions(table.joint_actions);
+	return table;
+}
+
+// Same rule as contains_collisions, evaluated for a whole table from the agent
+// positions only: two agents may not end on the same cell or enter each other's cell
+void Environment::mark_collisions(const State& state, const Joint_Action_Table& table, std::vector<bool>& collides) const {
+	// get_actions order
+	constexpr size_t direction_count = 5;
+	constexpr Direction directions[direction_count] = { Direction::UP, Direction::RIGHT, Direction::DOWN, Direction::LEFT, Direction::NONE };
+	assert(number_of_agents <= STATE_MAX_AGENTS);
+	std::array<Coordinate, STATE_MAX_AGENTS> current_coordinates;
+	std::array<std::array<Coordinate, direction_count>, STATE_MAX_AGENTS> next_coordinates;
+	for (size_t agent = 0; agent < number_of_agents; ++agent) {
+		current_coordinates[agent] = state.get_location(agent);
+		for (size_t index = 0; index < direction_count; ++index) {
+			next_coordinates[agent][index] = move(current_coordinates[agent], directions[index]);
+		}
+	}
+
+	collides.assign(table.size(), false);
+	for (size_t action_index = 0; action_index < table.size(); ++action_index) {
+		const auto& code = table.packed_actions[action_index];
+		for (size_t agent1 = 0; agent1 < number_of_agents && !collides[action_index]; ++agent1) {
+			const auto& next1 = next_coordinates[agent1][Joint_Action_Table::direction_index(code, agent1)];
+			for (size_t agent2 = agent1 + 1; agent2 < number_of_agents; ++agent2) {
+				const auto& next2 = next_coordinates[agent2][Joint_Action_Table::direction_index(code, agent2)];
+				if (next1 == next2
+					|| current_coordinates[agent1] == next2
+					|| current_coordinates[agent2] == next1) {
+					collides[action_index] = true;
+					break;
+				}
+			}
+		}
+	}
+}
+
 std::vector<Joint_Action> Environment::get_joint_actions(const Agent_Combination& agents) const {
 	std::vector<std::vector<Action>> single_actions;
 	std::vector<size_t> counters;
@@ -329,7 +375,7 @@ State Environment::load(const std::string& path) {
 		exit(-1);
 	}
 
-	State state;
+	std::vector<std::pair<Coordinate, Ingredient>> items;
 
 	size_t load_status = 0;
 	size_t line_counter = 0;
@@ -349,7 +395,7 @@ State Environment::load(const std::string& path) {
 		// Level file as defined by BD paper is split in 3 sections
 		switch (load_status) {
 		case 0: {
-			load_map_line(state, line_counter, line, width);
+			load_map_line(items, line_counter, line, width);
 			break;
 		}
 		case 1: { 
@@ -364,24 +410,27 @@ State Environment::load(const std::string& path) {
 			break;
 		}
 		}
-		std::stringstream buffer;
-		buffer << line_counter << ": " << line << std::endl;
-		PRINT(Print_Category::ENVIRONMENT, Print_Level::DEBUG, buffer.str());
+		PRINT(Print_Category::ENVIRONMENT, Print_Level::DEBUG, std::to_string(line_counter) + ": " + line + "\n");
 		++line_counter;
 	}
 
+	// Dimensions and walls are only known once the map section is read
+	flip_walls_array();
+	State state(*this);
+	for (const auto& [coordinate, ingredient] : items) {
+		state.add(coordinate, ingredient);
+	}
 	for (size_t agent = 0; agent < number_of_agents; ++agent) {
-		state.agents.push_back(agents_initial_positions.at(agent));
+		state.add_agent(agents_initial_positions.at(agent));
 	}
 
 	calculate_recipes();
 
-	flip_walls_array();
 	file.close();
 	return state;
 }
 
-void Environment::load_map_line(State& state, size_t& line_counter, const std::string& line, size_t width) {
+void Environment::load_map_line(std::vector<std::pair<Coordinate, Ingredient>>& items, size_t& line_counter, const std::string& line, size_t width) {
 
 	std::vector<bool> wall_line;
 	wall_line.reserve(width);
@@ -402,7 +451,7 @@ void Environment::load_map_line(State& state, size_t& line_counter, const std::s
 			Ingredient::DELIVERED_LETTUCE,	Ingredient::DELIVERED_SALAD,Ingredient::SALAD };
 
 		for (const auto& ingredient : state_ingredients) {
-			if (c == static_cast<char>(ingredient)) state.items.insert({ {index_counter, line_counter}, ingredient });
+			if (c == static_cast<char>(ingredient)) items.push_back({ {index_counter, line_counter}, ingredient });
 		}
 
 		++index_counter;
@@ -426,22 +475,24 @@ void Environment::print_state() const {
 	print_state(state);
 }
 void Environment::print_state(const State& state) const {
+	if (!is_print_allowed(Print_Category::ENVIRONMENT, Print_Level::DEBUG)) {
+		return;
+	}
 	std::string buffer;
 	for (size_t y = 0; y < walls.size(); ++y) {
 		for (size_t x = 0; x < walls.at(0).size(); ++x) {
-			auto agent_it = std::find_if(state.agents.begin(), state.agents.end(), [x, y](Agent agent)->bool {return agent.coordinate == Coordinate{x, y}; });
-			//auto agent_it = std::find_if(state.agents.begin(), state.agents.end(), Coordinate{ x, y }, [x, y](Agent agent)->bool {return agent.coordinate == {x, y}; });
+			auto agent = state.get_agent(Coordinate{ x, y });
+			auto item = state.get_ingredient_at_position({ x, y });
 
-			if (state.items.find({ x, y }) != state.items.end()) {
-				buffer += static_cast<char>(state.items.at({ x, y }));
+			if (item.has_value()) {
+				buffer += static_cast<char>(item.value());
 
-			} else if (agent_it != state.agents.end()) {
-				if (agent_it->item.has_value()) {
-					buffer += static_cast<char>(agent_it->item.value());
+			} else if (agent.has_value()) {
+				auto agent_item = state.get_agent_item(agent.value());
+				if (agent_item.has_value()) {
+					buffer += static_cast<char>(agent_item.value());
 				} else {
-					char buf[2];
-					sprintf(buf,"%d",std::distance(state.agents.begin(), agent_it));
-					buffer += buf[0];
+					buffer += std::to_string(agent.value().id).at(0);
 				}
 			
 			} else if (std::find(cutting_stations.begin(), cutting_stations.end(), Coordinate{ x, y }) != cutting_stations.end()) {
@@ -467,6 +518,7 @@ void Environment::print_state(const State& state) const {
 void Environment::play(State& state) const {
 	bool done = false;
 	Agent_Id agent = 0;
+	flush_print();
 	std::cout << "type {w, a, s, d} to move single agent, {w, a, s, d, n}* to move multiple agents, {0-9} to switch single agent, and {q} to quit" << std::endl;
 	for (std::string line; std::getline(std::cin, line) && !done;) {
 		char c = line[0];
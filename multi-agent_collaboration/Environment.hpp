@@ -12,6 +12,9 @@
 #include <set>
 #include <algorithm>
 #include <sstream>
+#include <cstdint>
+#include <bitset>
+#include <iterator>
 
 using Coordinate = std::pair<size_t, size_t> ;
 
@@ -187,152 +190,197 @@ struct Action {
 };
 
 
+// Largest agent id + 1 an Agent_Combination can hold
+constexpr size_t AGENT_COMBINATION_MAX_AGENTS = 64;
+
+inline size_t get_lowest_bit(uint64_t mask) {
+	assert(mask != 0);
+#if defined(__GNUC__) || defined(__clang__)
+	return static_cast<size_t>(__builtin_ctzll(mask));
+#else
+	size_t index = 0;
+	while ((mask & 1) == 0) {
+		mask >>= 1;
+		++index;
+	}
+	return index;
+#endif
+}
+
+/**
+Set of agents as a bitmask, bit i is Agent_Id i. Iterates in increasing id order and
+orders by size, then lexicographically, the same as the sorted vector it replaced.
+Formatting is left to to_string, nothing is kept besides the mask.
+*/
 struct Agent_Combination {
-	Agent_Combination() : agents() { generate_pretty_print(); }
-	explicit Agent_Combination(std::vector<Agent_Id> agents) : agents(agents) { generate_pretty_print(); }
-	explicit Agent_Combination(Agent_Id agent) : agents(1, agent) { generate_pretty_print(); }
+	class Iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Agent_Id;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const Agent_Id*;
+		using reference = Agent_Id;
+
+		explicit Iterator(uint64_t remaining) : remaining(remaining) {}
+		Agent_Id operator*() const {
+			return Agent_Id(get_lowest_bit(remaining));
+		}
+		Iterator& operator++() {
+			remaining &= remaining - 1;
+			return *this;
+		}
+		Iterator operator++(int) {
+			auto result = *this;
+			++(*this);
+			return result;
+		}
+		bool operator==(const Iterator& other) const {
+			return remaining == other.remaining;
+		}
+		bool operator!=(const Iterator& other) const {
+			return remaining != other.remaining;
+		}
+	private:
+		uint64_t remaining;
+	};
+
+	Agent_Combination() : mask(0) {}
+	explicit Agent_Combination(const std::vector<Agent_Id>& agents) : mask(0) {
+		for (const auto& agent : agents) {
+			add(agent);
+		}
+	}
+	explicit Agent_Combination(Agent_Id agent) : mask(get_bit(agent)) {}
 
-	std::vector<Agent_Id> agents;
-	std::string pretty_print;
+	static Agent_Combination from_mask(uint64_t mask) {
+		Agent_Combination result;
+		result.mask = mask;
+		return result;
+	}
 
 	void add(Agent_Id agent) {
-		agents.push_back(agent);
-		generate_pretty_print();
+		mask |= get_bit(agent);
 	}
 
-	void add(Agent_Combination agents_in) {
-		for (const auto& agent : agents_in) {
-			agents.push_back(agent);
-		}
-		generate_pretty_print();
+	void add(const Agent_Combination& agents_in) {
+		mask |= agents_in.mask;
 	}
 
 	bool operator<(const Agent_Combination& other) const {
-		if (agents.size() != other.agents.size()) return agents.size() < other.agents.size();
-		for (size_t i = 0; i < agents.size(); ++i) {
-			if (agents.at(i) != other.agents.at(i)) return agents.at(i) < other.agents.at(i);
-		}
-		return false;
+		if (mask == other.mask) return false;
+		auto this_size = size(), other_size = other.size();
+		if (this_size != other_size) return this_size < other_size;
+
+		// The set holding the lowest differing agent has the smaller sorted sequence
+		auto difference = mask ^ other.mask;
+		return (mask & difference & (~difference + 1)) != 0;
 	}
 
 	bool operator!=(const Agent_Combination& other) const {
-		if (agents.size() != other.agents.size()) return true;
-		for (size_t i = 0; i < agents.size(); ++i) {
-			if (agents.at(i) != other.agents.at(i)) return true;
-		}
-		return false;
+		return mask != other.mask;
 	}
 
 	bool operator==(const Agent_Combination& other) const {
-		if (agents.size() != other.agents.size()) return false;
-		for (size_t i = 0; i < agents.size(); ++i) {
-			if (agents.at(i) != other.agents.at(i)) return false;
-		}
-		return true;
+		return mask == other.mask;
 	}
 
 	bool contains(Agent_Id agent) const {
-		return std::find(agents.begin(), agents.end(), agent) != agents.end();
+		return agent.id < AGENT_COMBINATION_MAX_AGENTS && (mask >> agent.id & 1) != 0;
 	}
 
 	size_t get_index(Agent_Id agent) const {
-		size_t counter = 0;
-		for (const auto& entry : agents) {
-			if (entry == agent) return counter;
-			else ++counter;
-		}
-		return EMPTY_VAL;
-	}
-
-	std::vector<size_t> get_indices(Agent_Id agent) const {
-		std::vector<size_t> result;
-		size_t counter = 0;
-		for (const auto& entry : agents) {
-			if (entry == agent) result.push_back(counter);
-			++counter;
-		}
-		return result;
+		if (!contains(agent)) return EMPTY_VAL;
+		return count_bits(mask & ((uint64_t{ 1 } << agent.id) - 1));
 	}
 
 	Agent_Id get(size_t index) const {
-		assert(index < agents.size());
-		return agents.at(index);
+		assert(index < size());
+		auto remaining = mask;
+		for (size_t i = 0; i < index; ++i) {
+			remaining &= remaining - 1;
+		}
+		return Agent_Id(get_lowest_bit(remaining));
 	}
 
 	Agent_Id get_largest() const {
-		Agent_Id largest = agents.at(0);
-		for (const auto& agent : agents) {
-			if (largest < agent) {
-				largest = agent;
-			}
+		assert(mask != 0);
+		size_t largest = 0;
+		for (auto remaining = mask; remaining != 0; remaining &= remaining - 1) {
+			largest = get_lowest_bit(remaining);
 		}
-		return largest;
+		return Agent_Id(largest);
 	}
 
-	const std::vector<Agent_Id>& get() const {
-		return agents;
+	std::vector<Agent_Id> get() const {
+		return std::vector<Agent_Id>(begin(), end());
+	}
+
+	uint64_t get_mask() const {
+		return mask;
 	}
 
 	size_t size() const {
-		return agents.size();
+		return count_bits(mask);
 	}
 
 	bool empty() const {
-		return agents.empty();
+		return mask == 0;
 	}
 
-	const std::string& to_string() const {
-		return pretty_print;
+	std::string to_string() const {
+		std::string result = "(";
+		bool first = true;
+		for (const auto& agent : *this) {
+			if (first) first = false;
+			else result += ",";
+			result += std::to_string(agent.id);
+		}
+		result += ")";
+		return result;
 	}
 
 	std::string to_string_raw() const {
 		std::string result;
-		for (const auto& agent : agents) {
+		for (const auto& agent : *this) {
 			result += std::to_string(agent.id);
 		}
 		return result;
 	}
 
 	void remove(Agent_Id agent) {
-		auto it = std::find(agents.begin(), agents.end(), agent);
-		if (it != agents.end())	agents.erase(it);
-		generate_pretty_print();
+		if (agent.id < AGENT_COMBINATION_MAX_AGENTS) {
+			mask &= ~(uint64_t{ 1 } << agent.id);
+		}
 	}
 
-	std::vector<Agent_Id>::const_iterator begin() const {
-		return agents.begin();
+	Iterator begin() const {
+		return Iterator(mask);
 	}
 
-	std::vector<Agent_Id>::const_iterator end() const {
-		return agents.end();
+	Iterator end() const {
+		return Iterator(0);
 	}
 
-	Agent_Combination get_new_agents(Agent_Combination other) const {
-		std::vector<Agent_Id> result;
-		for (const auto& agent : other) {
-			if (!this->contains(agent)) {
-				result.push_back(agent);
-			}
-		}
-		return Agent_Combination(result);
+	Agent_Combination get_new_agents(const Agent_Combination& other) const {
+		return from_mask(other.mask & ~mask);
 	}
 
 	bool is_only_agent(Agent_Id agent) const {
-		return agents.size() == 1 && agents.at(0) == agent;
+		return contains(agent) && (mask & (mask - 1)) == 0;
 	}
 
 
 private:
-	void generate_pretty_print() {
-		pretty_print = "(";
-		bool first = true;
-		for (const auto& agent : agents) {
-			if (first) first = false;
-			else pretty_print += ",";
-			pretty_print += std::to_string(agent.id);
-		}
-		pretty_print += ")";
+	static uint64_t get_bit(Agent_Id agent) {
+		assert(agent.id < AGENT_COMBINATION_MAX_AGENTS);
+		return uint64_t{ 1 } << agent.id;
+	}
+
+	static size_t count_bits(uint64_t bits) {
+		return std::bitset<AGENT_COMBINATION_MAX_AGENTS>(bits).count();
 	}
+
+	uint64_t mask;
 };
 
 struct Joint_Action {
@@ -388,6 +436,14 @@ struct Joint_Action {
 		return actions.size();
 	}
 
+	bool operator==(const Joint_Action& other) const {
+		return actions == other.actions;
+	}
+
+	bool operator!=(const Joint_Action& other) const {
+		return !(*this == other);
+	}
+
 	std::string to_string() const{
 		bool first = true;
 		std::stringstream buffer;
@@ -402,6 +458,178 @@ struct Joint_Action {
 	}
 };
 
+/**
+Joint_Action packed into one integer with BITS_PER_AGENT bits per agent, indexed by agent id.
+A field is 0 when the agent has no action, otherwise 1 + the direction's index in get_actions
+order. Converting back yields the actions in increasing agent order, which is how every joint
+action in the planners is built.
+*/
+struct Packed_Joint_Action {
+	static constexpr size_t BITS_PER_AGENT = 3;
+	static constexpr size_t MAX_AGENTS = 32 / BITS_PER_AGENT;
+	static constexpr uint32_t FIELD_MASK = (1u << BITS_PER_AGENT) - 1;
+	static constexpr uint32_t LOW_BITS = 0x09249249u;	// Lowest bit of every field
+	static_assert(MAX_AGENTS == 10, "LOW_BITS covers 10 fields");
+
+	Packed_Joint_Action() : code(0) {}
+	explicit Packed_Joint_Action(const Joint_Action& joint_action) : code(0) {
+		for (const auto& action : joint_action.actions) {
+			assert(action.agent.id < MAX_AGENTS);
+			code |= to_field(action.direction) << get_shift(action.agent);
+		}
+	}
+
+	uint32_t code;
+
+	static uint32_t get_field_mask(Agent_Id agent) {
+		return agent.id < MAX_AGENTS ? FIELD_MASK << get_shift(agent) : 0;
+	}
+
+	static uint32_t get_field_mask(const Agent_Combination& agents) {
+		uint32_t result = 0;
+		for (const auto& agent : agents) {
+			result |= get_field_mask(agent);
+		}
+		return result;
+	}
+
+	// Fields of the agents which have an action
+	uint32_t get_presence_mask() const {
+		return ((code | code >> 1 | code >> 2) & LOW_BITS) * FIELD_MASK;
+	}
+
+	uint32_t get_field(Agent_Id agent) const {
+		return agent.id < MAX_AGENTS ? (code >> get_shift(agent)) & FIELD_MASK : 0;
+	}
+
+	bool contains(Agent_Id agent) const {
+		return get_field(agent) != 0;
+	}
+
+	Action get_action(const Agent_Id& agent) const {
+		auto field = get_field(agent);
+		if (field == 0) {
+			std::stringstream buffer;
+			buffer << "Unknown agent " << agent.id << "\n";
+			throw std::runtime_error(buffer.str());
+		}
+		return { to_direction(field), agent };
+	}
+
+	// Adds the agent's action, or replaces it
+	void set_action(const Action& action) {
+		assert(action.agent.id < MAX_AGENTS);
+		code = (code & ~get_field_mask(action.agent)) | to_field(action.direction) << get_shift(action.agent);
+	}
+
+	void update_action(Agent_Id agent, Direction direction) {
+		if (!contains(agent)) {
+			std::stringstream buffer;
+			buffer << "Unknown agent " << agent.id << "\n";
+			throw std::runtime_error(buffer.str());
+		}
+		code = (code & ~get_field_mask(agent)) | to_field(direction) << get_shift(agent);
+	}
+
+	bool is_not_none(Agent_Id agent) const {
+		auto field = get_field(agent);
+		return field != 0 && field != to_field(Direction::NONE);
+	}
+
+	// Equal on every field in field_mask
+	bool matches(const Packed_Joint_Action& other, uint32_t field_mask) const {
+		return ((code ^ other.code) & field_mask) == 0;
+	}
+
+	// false if handoff action
+	bool is_action_valid() const {
+		return code != 0;
+	}
+
+	size_t size() const {
+		return std::bitset<32>((code | code >> 1 | code >> 2) & LOW_BITS).count();
+	}
+
+	Joint_Action to_joint_action() const {
+		std::vector<Action> actions;
+		for (size_t agent = 0; agent < MAX_AGENTS; ++agent) {
+			auto field = get_field(agent);
+			if (field != 0) {
+				actions.emplace_back(to_direction(field), Agent_Id{ agent });
+			}
+		}
+		return Joint_Action(std::move(actions));
+	}
+
+	std::string to_string() const {
+		return to_joint_action().to_string();
+	}
+
+	bool operator==(const Packed_Joint_Action& other) const {
+		return code == other.code;
+	}
+
+	bool operator!=(const Packed_Joint_Action& other) const {
+		return code != other.code;
+	}
+
+	static uint32_t to_field(Direction direction) {
+		switch (direction) {
+		case Direction::UP: return 1;
+		case Direction::RIGHT: return 2;
+		case Direction::DOWN: return 3;
+		case Direction::LEFT: return 4;
+		default: return 5;
+		}
+	}
+
+	static Direction to_direction(uint32_t field) {
+		constexpr Direction directions[] = { Direction::NONE, Direction::UP, Direction::RIGHT, 
+			Direction::DOWN, Direction::LEFT, Direction::NONE };
+		assert(field > 0 && field < 6);
+		return directions[field];
+	}
+
+private:
+	static uint32_t get_shift(Agent_Id agent) {
+		return static_cast<uint32_t>(agent.id * BITS_PER_AGENT);
+	}
+};
+
+inline std::vector<Packed_Joint_Action> pack_joint_actions(const std::vector<Joint_Action>& joint_actions) {
+	std::vector<Packed_Joint_Action> result;
+	result.reserve(joint_actions.size());
+	for (const auto& joint_action : joint_actions) {
+		result.emplace_back(joint_action);
+	}
+	return result;
+}
+
+inline std::vector<Joint_Action> unpack_joint_actions(const std::vector<Packed_Joint_Action>& joint_actions) {
+	std::vector<Joint_Action> result;
+	result.reserve(joint_actions.size());
+	for (const auto& joint_action : joint_actions) {
+		result.push_back(joint_action.to_joint_action());
+	}
+	return result;
+}
+
+// Joint actions of an agent combination, precomputed once in both encodings.
+// Every agent has an action, agents outside the combination have NONE.
+struct Joint_Action_Table {
+	std::vector<Joint_Action> joint_actions;
+	std::vector<Packed_Joint_Action> packed_actions;
+
+	size_t size() const {
+		return packed_actions.size();
+	}
+
+	// Index into get_actions order
+	static size_t direction_index(const Packed_Joint_Action& action, size_t agent) {
+		return action.get_field(Agent_Id{ agent }) - 1;
+	}
+};
+
 struct Agent {
 	Agent(Coordinate coordinate)
 		: coordinate(coordinate), item() {};
@@ -436,6 +664,7 @@ struct Agent {
 		this->coordinate = coordinate;
 	}
 	void print_compact(Agent_Id id) const {
+		flush_print();
 		std::cout << "(" << id.id << ", " << coordinate.first << ", " << coordinate.second << ") ";
 		if (item.has_value()) {
 			std::cout << "(" << static_cast<char>(item.value()) << ", " << coordinate.first << ", " << coordinate.second << ") ";
@@ -461,14 +690,17 @@ public:
 	bool			act(State& state, const Action& action, Print_Level print_level) const;
 	bool			act(State& state, const Joint_Action& action) const;
 	bool			act(State& state, const Joint_Action& action, Print_Level print_level) const;
+	bool			contains_collisions(const State& state, const Joint_Action& joint_action) const;
 	Joint_Action	convert_to_joint_action(const Action& action, Agent_Id agent) const;
 	bool			do_ingredients_lead_to_goal(const Ingredients& ingredients_count) const;
 	bool			is_action_none_nav(const Coordinate& coordinate, const Action& action) const;
+	bool			is_action_valid(const State& state, const Action& action) const;
 	bool			is_cell_type(const Coordinate& coordinate, const Cell_Type& type) const;
 	bool			is_cell_type(const Coordinate& coordinate, const Direction& direction, const Cell_Type& type) const;
 	bool			is_done(const State& state) const;
 	bool			is_inbound(const Coordinate& coordiante) const;
 	bool			is_type_stationary(Ingredient ingredient) const;
+	void			mark_collisions(const State& state, const Joint_Action_Table& table, std::vector<bool>& collides) const;
 	State			load(const std::string& path);
 	Coordinate		move(const Coordinate& coordinate, Direction direction) const;
 	Coordinate		move_noclip(const Coordinate& coordinate, Direction direction) const;
@@ -482,6 +714,7 @@ public:
 	Direction					get_direction(const Coordinate& source, const Coordinate& dest) const;
 	size_t						get_height() const;
 	std::vector<Joint_Action>	get_joint_actions(const Agent_Combination& agents) const;
+	Joint_Action_Table			get_joint_action_table(const Agent_Combination& agents) const;
 	std::vector<Location>		get_locations(const State& state, Ingredient ingredient) const;
 	std::vector<Coordinate>		get_neighbours(Coordinate location) const;
 	std::vector<Location>		get_non_wall_locations(const State& state, Ingredient ingredient) const;
@@ -493,12 +726,12 @@ public:
 
 private:
 	void						calculate_recipes();
-	bool						contains_collisions(const State& state, const Joint_Action& joint_action) const;
 	bool						does_recipe_lead_to_goal(const Ingredients& ingredients_count, const Recipe& recipe_in) const;
 	void						flip_walls_array();
 	std::optional<Ingredient>	get_recipe(Ingredient ingredient1, Ingredient ingredient2) const;
 	Ingredient					goal_name_to_ingredient(const std::string& name) const;
-	void						load_map_line(State& state, size_t& line_counter, const std::string& line, size_t width);
+	void						load_map_line(std::vector<std::pair<Coordinate, Ingredient>>& items, size_t& line_counter, 
+									const std::string& line, size_t width);
 	void						load_recipes();
 	void						reset();
 
@@ -4,6 +4,10 @@
 
 #include <deque>
 #include <cassert>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 
 #define INFINITE_HEURISTIC 1000
 struct Location_Info {
@@ -11,6 +15,24 @@ struct Location_Info {
 	size_t wall_penalty;
 };
 
+struct Distance_Entry {
+	Distance_Entry() :g(EMPTY_VAL), parent(EMPTY_VAL, EMPTY_VAL), wall_g(0) {}
+	Distance_Entry(size_t g) :g(g), parent(EMPTY_VAL, EMPTY_VAL), wall_g(0) {}
+	size_t g;
+	Coordinate parent;
+	size_t wall_g;
+};
+
+// Index of a direction in get_neighbours order
+static size_t direction_index(Direction direction) {
+	switch (direction) {
+	case Direction::UP:		return 0;
+	case Direction::RIGHT:	return 1;
+	case Direction::DOWN:	return 2;
+	default:				return 3;
+	}
+}
+
 struct Search_Entry {
 	Search_Entry(Coordinate coord, size_t dist, size_t walls, size_t wall_g) 
 		: coord(coord), dist(dist), walls(walls), wall_g(wall_g) {}
@@ -20,11 +42,9 @@ struct Search_Entry {
 	size_t wall_g;
 };
 
-Heuristic::Heuristic(Environment environment) : environment(environment),
-	ingredient1(Ingredient::DELIVERY), ingredient2(Ingredient::DELIVERY),
-	handoff_agent(), agent_combinations(get_combinations(environment.get_number_of_agents())) {
-
-	init();
+Heuristic::Heuristic(Environment environment) : distances(Distance_Table::get(environment)),
+	environment(environment), ingredient1(Ingredient::DELIVERY), ingredient2(Ingredient::DELIVERY),
+	other_item(Ingredient::CUTTING), handoff_agent(), agent_combinations(get_combinations(environment.get_number_of_agents())) {
 }
 
 void Heuristic::set(Ingredient ingredient1, Ingredient ingredient2, const Agent_Combination& agents,
@@ -34,13 +54,24 @@ void Heuristic::set(Ingredient ingredient1, Ingredient ingredient2, const Agent_
 	this->ingredient2 = ingredient2;
 	this->agent_combinations = get_combinations(agents);
 	this->handoff_agent = handoff_agent;
+
+	// Never an item, but may be an ingredient of the recipe
+	this->other_item = Ingredient::CUTTING;
+	if (ingredient1 == other_item || ingredient2 == other_item) {
+		this->other_item = Ingredient::DELIVERY;
+	}
+}
+
+State Heuristic::get_projection(const State& state) const {
+	return state.get_projection(ingredient1, ingredient2, other_item);
 }
 
 std::pair<size_t, Direction> Heuristic::get_dist_direction(Coordinate source, Coordinate dest, size_t walls) const {
-	auto& dist_ref = distances.at(walls).const_at(dest, source);
-	std::pair<size_t, Direction> temp{ dist_ref.g, environment.get_direction(source, dist_ref.parent) };
+	std::pair<size_t, Direction> temp{ distances->get_distance(dest, source, walls), 
+		environment.get_direction(source, distances->get_parent(dest, source, walls)) };
+	flush_print();
 	std::cout << source.first << ","<< source.second << " to " << dest.first << "," << dest.second << ": dist " << temp.first << ", direction " << static_cast<char>(temp.second) << std::endl;
-	return { dist_ref.g, environment.get_direction(source, dist_ref.parent) };
+	return temp;
 }
 
 size_t Heuristic::get_distance_to_nearest_wall(Coordinate agent_coord, Coordinate blocked, const State& state) const {
@@ -77,16 +108,15 @@ Helper_Agent_Info Heuristic::find_helper(const std::vector<Helper_Agent_Info>& h
 
 	size_t min_dist = EMPTY_VAL;
 	Agent_Id min_agent = {};
-	const auto& dist_agent_ref = distances.at(0);
 	for (const auto& agent_id : local_agents) {
 
 		// First will be the last agent to move, i.e. should not be handoff_agent
 		if (first && handoff_agent.is_not_empty() && handoff_agent == agent_id) {
 			continue;
 		}
-		const auto& agent_ref = state.agents.at(agent_id.id);
+		const auto agent_ref = state.get_agent(agent_id);
 		const auto& agent_coord = agent_ref.coordinate;
-		const auto& dist = dist_agent_ref.const_at(agent_coord, prev);
+		const auto dist = distances->get_distance(agent_coord, prev, 0);
 		size_t holding_penalty = 0;
 
 		if (agent_ref.item.has_value() 
@@ -96,8 +126,8 @@ Helper_Agent_Info Heuristic::find_helper(const std::vector<Helper_Agent_Info>& h
 			holding_penalty = get_distance_to_nearest_wall(agent_coord, next, state);
 		}
 
-		if (dist.g + holding_penalty < min_dist) {
-			min_dist = dist.g + holding_penalty;
+		if (dist + holding_penalty < min_dist) {
+			min_dist = dist + holding_penalty;
 			min_agent = agent_id;
 		}
 	}
@@ -120,8 +150,8 @@ Helper_Agent_Distance Heuristic::get_helper_agents_distance(Coordinate source, C
 	size_t path_length = 1;
 	bool first = true;
 	while (true) {
-		auto& prev_dist = distances.at(walls_to_penetrate).const_at(source, prev);
-		if (prev_dist.parent == source) {
+		auto parent = distances->get_parent(source, prev, walls_to_penetrate);
+		if (parent == source) {
 			auto helper = find_helper(helpers, handoff_agent, local_agents, first, state, source, { EMPTY_VAL, EMPTY_VAL }, path_length);
 			if (!helper.has_value()) {
 				return { };
@@ -137,11 +167,11 @@ Helper_Agent_Distance Heuristic::get_helper_agents_distance(Coordinate source, C
 
 			break;
 		}
-		if (prev_dist.parent == Coordinate{EMPTY_VAL, EMPTY_VAL}) {
+		if (parent == Coordinate{EMPTY_VAL, EMPTY_VAL}) {
 			return { };
 		}
 
-		auto next = prev_dist.parent;
+		auto next = parent;
 
 		++path_length;
 		if (environment.is_cell_type(next, Cell_Type::WALL)) {
@@ -179,7 +209,7 @@ Helper_Agent_Distance Heuristic::get_helper_agents_distance(Coordinate source, C
 		//first = false;
 	}
 	bool was_handed_off = helpers.size() > 1;
-	assert((distances.at(walls_to_penetrate).const_at(source, destination).g == path_length));
+	assert((distances->get_distance(source, destination, walls_to_penetrate) == path_length));
 	return { std::max(forward_length, reverse_length), was_handed_off };
 }
 
@@ -259,31 +289,82 @@ size_t Heuristic::operator()(const State& state, const Agent_Combination& agents
 	return min_dist;
 }
 
-size_t Heuristic::convert(const Coordinate& coord1) const {
-	return coord1.first * environment.get_height() + coord1.second;
-}
-
 void Heuristic::print_distances(Coordinate coordinate, size_t agent_number) const {
+	flush_print();
 	std::cout << "\nPrinting distances for " << agent_number << " agents from (" << coordinate.first << ", " << coordinate.second << ")" << std::endl;
 	for (size_t y = 0; y < environment.get_height(); ++y) {
 		for (size_t x = 0; x < environment.get_width(); ++x) {
-			const auto& temp = distances.at(agent_number - 1).const_at(coordinate, { x,y });
-			std::cout << (temp.g == EMPTY_VAL ? "--" : (temp.g < 10 ? "0" : "") + std::to_string(temp.g)) << " ";
+			auto g = distances->get_distance(coordinate, { x,y }, agent_number - 1);
+			std::cout << (g == EMPTY_VAL ? "--" : (g < 10 ? "0" : "") + std::to_string(g)) << " ";
 		}
 		std::cout << std::endl;
 	}
 	std::cout << "\nPrinting directions for " << agent_number << " agents from (" << coordinate.first << ", " << coordinate.second << ")" << std::endl;
 	for (size_t y = 0; y < environment.get_height(); ++y) {
 		for (size_t x = 0; x < environment.get_width(); ++x) {
-			const auto& temp = distances.at(agent_number - 1).const_at(coordinate, { x,y });
-			std::cout << (temp.g == EMPTY_VAL ? '-' : static_cast<char>(get_direction({ x, y }, temp.parent))) << " ";
+			auto g = distances->get_distance(coordinate, { x,y }, agent_number - 1);
+			auto parent = distances->get_parent(coordinate, { x,y }, agent_number - 1);
+			std::cout << (g == EMPTY_VAL ? '-' : static_cast<char>(get_direction({ x, y }, parent))) << " ";
 		}
 		std::cout << std::endl;
 	}
 }
 
+std::shared_ptr<const Distance_Table> Distance_Table::get(const Environment& environment) {
+	static std::mutex mutex;
+	static std::map<std::string, std::weak_ptr<const Distance_Table>> tables;
+
+	// Distances only depend on the dimensions, the walls and the number of agents
+	std::string key = std::to_string(environment.get_width()) + "x" + std::to_string(environment.get_height())
+		+ ":" + std::to_string(environment.get_number_of_agents()) + ":";
+	for (size_t x = 0; x < environment.get_width(); ++x) {
+		for (size_t y = 0; y < environment.get_height(); ++y) {
+			key += environment.is_cell_type({ x, y }, Cell_Type::WALL) ? '1' : '0';
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto table = tables[key].lock();
+	if (!table) {
+		table = std::make_shared<const Distance_Table>(environment);
+		tables[key] = table;
+	}
+	return table;
+}
+
+size_t Distance_Table::convert(const Coordinate& coordinate) const {
+	return coordinate.first * height + coordinate.second;
+}
+
+const Distance_Table::Entry& Distance_Table::entry(const Coordinate& source, const Coordinate& destination, size_t walls) const {
+	return entries.at((walls * cell_count + convert(source)) * cell_count + convert(destination));
+}
+
+size_t Distance_Table::get_distance(const Coordinate& source, const Coordinate& destination, size_t walls) const {
+	auto g = entry(source, destination, walls).g;
+	return g == UNREACHABLE ? EMPTY_VAL : g;
+}
+
+Coordinate Distance_Table::get_parent(const Coordinate& source, const Coordinate& destination, size_t walls) const {
+	switch (entry(source, destination, walls).parent) {
+	case 0:	return { destination.first, destination.second - 1 };
+	case 1:	return { destination.first + 1, destination.second };
+	case 2:	return { destination.first, destination.second + 1 };
+	case 3:	return { destination.first - 1, destination.second };
+	default: return { EMPTY_VAL, EMPTY_VAL };
+	}
+}
+
 // All pairs shortest path for all amounts of agents, taking wall-handover in to account
-void Heuristic::init() {
+Distance_Table::Distance_Table(const Environment& environment)
+	: entries(), width(environment.get_width()), height(environment.get_height()),
+	cell_count(environment.get_width() * environment.get_height()) {
+
+	if (cell_count >= UNREACHABLE) {
+		throw std::runtime_error("Level of " + std::to_string(cell_count) + " cells is too large for the distance table");
+	}
+	entries.resize(environment.get_number_of_agents() * cell_count * cell_count, { UNREACHABLE, NO_PARENT });
+
 	// Get all possible coordinates
 	std::vector<Coordinate> coordinates;
 	for (size_t x = 0; x < environment.get_width(); ++x) {
@@ -295,8 +376,6 @@ void Heuristic::init() {
 	// Loop agent sizes
 	for (size_t current_agents = 0; current_agents < environment.get_number_of_agents(); ++current_agents) {
 		size_t max_walls = current_agents;
-		distances.emplace_back(environment.get_width(), environment.get_height());
-		auto& final_dist = distances.back();
 
 		// Loop all source coordiantes
 		for (const auto& source : coordinates) {
@@ -344,19 +423,28 @@ void Heuristic::init() {
 			}
 
 			// Recorded the smallest dist among the distances from different wall values
+			std::vector<Distance_Entry> final_dist(cell_count);
 			for (const auto& dist : temp_distances) {
 				for (const auto& destination : coordinates) {
-					auto& ref_dist = final_dist.at(source, destination);
+					auto& ref_dist = final_dist.at(convert(destination));
 					if (ref_dist.g == EMPTY_VAL || dist.at(convert(destination)).g <= ref_dist.g) {
 						ref_dist = dist.at(convert(destination));
 					}
 				}
 			}
 
+			// Compact, the parent is stored as the direction from the destination
+			for (const auto& destination : coordinates) {
+				const auto& ref_dist = final_dist.at(convert(destination));
+				auto& compact = entries.at((current_agents * cell_count + convert(source)) * cell_count + convert(destination));
+				if (ref_dist.g != EMPTY_VAL) {
+					compact.g = static_cast<uint16_t>(ref_dist.g);
+				}
+				if (ref_dist.parent != Coordinate{ EMPTY_VAL, EMPTY_VAL }) {
+					compact.parent = static_cast<uint8_t>(direction_index(environment.get_direction(destination, ref_dist.parent)));
+				}
+			}
+
 		}
 	}
-
-	//print_distances({ 5,5 }, 2);
-	//print_distances({ 1,1 }, 2);
-	//print_distances({ 5,0 }, 2);
 }
\ No newline at end of file
@@ -1,35 +1,47 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 #include "Environment.hpp"
+#include "State.hpp"
 
 
-struct Distance_Entry {
-	Distance_Entry() :g(EMPTY_VAL), parent(EMPTY_VAL, EMPTY_VAL), wall_g(0) {}
-	Distance_Entry(size_t g) :g(g), parent(EMPTY_VAL, EMPTY_VAL), wall_g(0) {}
-	Distance_Entry(size_t g, Coordinate parent) : g(g), parent(parent), wall_g(0) {}
-	Distance_Entry(size_t g, Coordinate parent, size_t wall_g) : g(g), parent(parent), wall_g(wall_g) {}
-	size_t g;
-	Coordinate parent;
-	size_t wall_g;
-};
-struct Distances {
-	Distances(size_t width, size_t height)
-		: distances(width* height, std::vector<Distance_Entry>(width* height)),
-		width(width), height(height) {};
-	std::vector<std::vector<Distance_Entry>> distances;
-	size_t width;
-	size_t height;
-	constexpr size_t convert(const Coordinate& coord1) const {
-		return coord1.first * height + coord1.second;
-	}
+/**
+All pairs shortest paths for every number of walls a path may cross, taking
+wall-handovers into account. Built once per level layout and shared read-only
+between all heuristics, planners and threads through get().
+Entries hold the distance, and the direction from the destination to its
+parent on the path from the source.
+*/
+class Distance_Table {
+public:
+	explicit Distance_Table(const Environment& environment);
 
-	const Distance_Entry& const_at(Coordinate coord1, Coordinate coord2) const {
-		return distances.at(convert(coord1)).at(convert(coord2));
-	}
+	static std::shared_ptr<const Distance_Table> get(const Environment& environment);
 
-	Distance_Entry& at(Coordinate coord1, Coordinate coord2) {
-		return distances.at(convert(coord1)).at(convert(coord2));
-	}
+	// EMPTY_VAL if unreachable
+	size_t		get_distance(const Coordinate& source, const Coordinate& destination, size_t walls) const;
+
+	// {EMPTY_VAL, EMPTY_VAL} for the source itself or when unreachable
+	Coordinate	get_parent(const Coordinate& source, const Coordinate& destination, size_t walls) const;
+
+private:
+	struct Entry {
+		uint16_t g;
+		uint8_t parent;
+	};
+	static constexpr uint16_t UNREACHABLE = 0xFFFF;
+	static constexpr uint8_t NO_PARENT = 4;
+
+	size_t			convert(const Coordinate& coordinate) const;
+	const Entry&	entry(const Coordinate& source, const Coordinate& destination, size_t walls) const;
+
+	std::vector<Entry> entries;		// Indexed [walls][source][destination]
+	size_t width;
+	size_t height;
+	size_t cell_count;
 };
 
 struct Helper_Agent_Distance {
@@ -73,6 +85,10 @@ public:
 		const Agent_Id& handoff_agent);
 	std::pair<size_t, Direction> get_dist_direction(Coordinate source, Coordinate dest, size_t walls) const;
 
+	// The part of state the heuristic reads for the ingredients of the last set, states with
+	// equal projections have equal heuristic values
+	State get_projection(const State& state) const;
+
 private:
 	Helper_Agent_Distance  get_helper_agents_distance(Coordinate source, Coordinate destination, const State& state,
 		const Agent_Id handoff_agent, const Agent_Combination& local_agents, const bool& require_handoff_action,
@@ -83,17 +99,16 @@ private:
 	
 	size_t get_nearest_agent_distance(const State& state, Location location, const Agent_Id& handoff_agent, const Agent_Combination& local_agents) const;
 	bool are_items_available (const Location& location1, const Location& location2, const State& state, const Agent_Combination& local_agents) const;
-	size_t convert(const Coordinate& coord1) const;
 	void print_distances(Coordinate coordinate, size_t agent_number) const;
-	void init();
 	size_t get_distance_to_nearest_wall(Coordinate agent_coord, Coordinate blocked, const State& state) const;
 	Helper_Agent_Info find_helper(const std::vector<Helper_Agent_Info>& helpers, const Agent_Id handoff_agent, const Agent_Combination& local_agents, const bool first,
 		const State& state, const Coordinate& prev, const Coordinate& next, const size_t path_length) const;
 
-	std::vector<Distances> distances;	// Vector index is the amount of walls intersected on the path
+	std::shared_ptr<const Distance_Table> distances;
 	Environment environment;
 	Ingredient ingredient1;
 	Ingredient ingredient2;
+	Ingredient other_item;		// Stands in for items which are neither ingredient in projections
 	//Agent_Combination agents;
 	std::optional<Agent_Id> handoff_agent;
 	std::vector<Agent_Combination> agent_combinations;
@@ -0,0 +1,158 @@
+#include "Plan_Cache.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+std::string Plan_Cache_Stats::to_string() const {
+	std::stringstream buffer;
+	buffer << "Plan cache: " << hits << " hits, " << tail_hits << " tail hits, "
+		<< infeasible_hits << " infeasible hits, " << misses << " misses, " << evictions << " evictions";
+	return buffer.str();
+}
+
+Plan_Cache::Plan_Cache(const Environment& environment, size_t capacity)
+	: environment(environment), capacity(capacity), entries(), index(), infeasible(), stats() {}
+
+size_t Plan_Cache::Key_Hasher::operator()(const Key& key) const {
+	uint64_t goal_tag = static_cast<uint64_t>(key.goal.recipe.result) << 8
+		| static_cast<uint64_t>(key.goal.handoff_agent.id & 0xFF);
+	for (const auto& agent : key.goal.agents) {
+		goal_tag = (goal_tag << 4) ^ (agent.id + 1);
+	}
+	return key.state.to_hash() ^ State::zobrist_key((4ull << 32) ^ goal_tag);
+}
+
+std::optional<std::vector<Joint_Action>> Plan_Cache::get(const State& state, const Goal& goal) {
+	Key key{ state, goal };
+	auto it = index.find(key);
+	if (it == index.end()) {
+		if (!infeasible.empty() && infeasible.find(get_abstraction(state, goal)) != infeasible.end()) {
+			++stats.infeasible_hits;
+			return std::vector<Joint_Action>{};
+		}
+		++stats.misses;
+		return {};
+	}
+	entries.splice(entries.begin(), entries, it->second);
+	const auto& entry = *it->second;
+	if (entry.is_tail) {
+		++stats.tail_hits;
+	} else {
+		++stats.hits;
+	}
+	auto path = entry.path;
+	put_tail(key, path);
+	return path;
+}
+
+const Plan_Cache_Stats& Plan_Cache::get_stats() const {
+	return stats;
+}
+
+void Plan_Cache::insert(const State& state, const Goal& goal, const std::vector<Joint_Action>& path, bool exhaustive) {
+	Key key{ state, goal };
+	put(key, path, false);
+	put_tail(key, path);
+
+	if (path.empty() && exhaustive) {
+		if (infeasible.size() == capacity) {
+			infeasible.clear();
+		}
+		infeasible.insert(get_abstraction(state, goal));
+	}
+}
+
+Plan_Cache::Key Plan_Cache::get_abstraction(const State& state, const Goal& goal) const {
+	auto width = environment.get_width();
+	auto height = environment.get_height();
+	auto agent_count = state.get_number_of_agents();
+
+	// Agents outside the goal never move during the search and block their cells
+	std::vector<bool> open(width * height, false);
+	for (size_t x = 0; x < width; ++x) {
+		for (size_t y = 0; y < height; ++y) {
+			open.at(x * height + y) = !environment.is_cell_type({ x, y }, Cell_Type::WALL);
+		}
+	}
+	for (size_t agent = 0; agent < agent_count; ++agent) {
+		if (!goal.agents.contains(Agent_Id(agent))) {
+			auto location = state.get_location(Agent_Id(agent));
+			open.at(location.first * height + location.second) = false;
+		}
+	}
+
+	// Flood fill open regions, labelled by their first cell in scan order
+	std::vector<size_t> region(width * height, EMPTY_VAL);
+	std::vector<Coordinate> frontier;
+	for (size_t start = 0; start < region.size(); ++start) {
+		if (!open.at(start) || region.at(start) != EMPTY_VAL) {
+			continue;
+		}
+		region.at(start) = start;
+		frontier.push_back({ start / height, start % height });
+		while (!frontier.empty()) {
+			auto current = frontier.back();
+			frontier.pop_back();
+			for (const auto& neighbour : environment.get_neighbours(current)) {
+				if (!environment.is_inbound(neighbour)) {
+					continue;
+				}
+				auto cell = neighbour.first * height + neighbour.second;
+				if (open.at(cell) && region.at(cell) == EMPTY_VAL) {
+					region.at(cell) = start;
+					frontier.push_back(neighbour);
+				}
+			}
+		}
+	}
+
+	// Agents sharing a region may block each other, so they keep their exact location
+	Key key{ state, goal };
+	auto agents = goal.agents.get();
+	std::vector<size_t> agent_regions;
+	for (const auto& agent : agents) {
+		auto location = state.get_location(agent);
+		agent_regions.push_back(region.at(location.first * height + location.second));
+	}
+	for (size_t i = 0; i < agent_regions.size(); ++i) {
+		if (std::count(agent_regions.begin(), agent_regions.end(), agent_regions.at(i)) == 1) {
+			auto cell = agent_regions.at(i);
+			key.state.move_agent(agents.at(i), { cell / height, cell % height });
+		}
+	}
+	return key;
+}
+
+void Plan_Cache::put(const Key& key, const std::vector<Joint_Action>& path, bool is_tail) {
+	auto it = index.find(key);
+	if (it != index.end()) {
+
+		// Searched results are never replaced by derived tails
+		if (is_tail && !it->second->is_tail) {
+			return;
+		}
+		it->second->path = path;
+		it->second->is_tail = is_tail;
+		entries.splice(entries.begin(), entries, it->second);
+		return;
+	}
+
+	if (entries.size() == capacity) {
+		index.erase(entries.back().key);
+		entries.pop_back();
+		++stats.evictions;
+	}
+	entries.push_front({ key, path, is_tail });
+	index.insert({ key, entries.begin() });
+}
+
+void Plan_Cache::put_tail(const Key& key, const std::vector<Joint_Action>& path) {
+	if (path.size() < 2) {
+		return;
+	}
+	Key next_key = key;
+	if (!environment.act(next_key.state, path.front(), Print_Level::NOPE)) {
+		return;
+	}
+	put(next_key, std::vector<Joint_Action>(path.begin() + 1, path.end()), true);
+}
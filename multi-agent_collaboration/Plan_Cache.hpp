@@ -0,0 +1,77 @@
+#pragma once
+
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Environment.hpp"
+#include "State.hpp"
+#include "Recogniser.hpp"
+
+struct Plan_Cache_Stats {
+	Plan_Cache_Stats() : hits(0), tail_hits(0), infeasible_hits(0), misses(0), evictions(0) {}
+	size_t hits;			// Exact state and goal was searched before
+	size_t tail_hits;		// State was reached by following the first step of a cached path
+	size_t infeasible_hits;	// Search skipped, goal failed exhaustively in an equivalent state
+	size_t misses;
+	size_t evictions;
+
+	std::string to_string() const;
+};
+
+/**
+Bounded LRU cache of unconstrained search_joint results keyed on (state, goal).
+Searches are deterministic, so an exact hit returns what the search would.
+Every stored path also stores its tail under the state reached by its first
+joint action, so when all agents follow the plan for a step the next search
+is answered from the cache. The tail of an optimal path is itself optimal.
+Empty results (no path) are cached for exact hits. An exhaustive failure, one
+without depth cutoffs, is also stored under an abstraction of the state where
+each goal agent alone in its open region is moved to the first cell of that
+region. It can walk there and back without touching anything, so every state
+with the same abstraction reaches the same states and fails too.
+*/
+class Plan_Cache {
+public:
+	Plan_Cache(const Environment& environment, size_t capacity);
+
+	std::optional<std::vector<Joint_Action>>	get(const State& state, const Goal& goal);
+	const Plan_Cache_Stats&						get_stats() const;
+	void										insert(const State& state, const Goal& goal, const std::vector<Joint_Action>& path, 
+													bool exhaustive = false);
+
+private:
+	struct Key {
+		State state;
+		Goal goal;
+		bool operator==(const Key& other) const {
+			return state == other.state && goal == other.goal;
+		}
+	};
+
+	struct Key_Hasher {
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry {
+		Key key;
+		std::vector<Joint_Action> path;
+		bool is_tail;
+	};
+
+	using Entry_List = std::list<Entry>;
+
+	Key get_abstraction(const State& state, const Goal& goal) const;
+	void put(const Key& key, const std::vector<Joint_Action>& path, bool is_tail);
+	void put_tail(const Key& key, const std::vector<Joint_Action>& path);
+
+	Environment environment;
+	size_t capacity;
+	Entry_List entries;		// Most recently used first
+	std::unordered_map<Key, Entry_List::iterator, Key_Hasher> index;
+	std::unordered_set<Key, Key_Hasher> infeasible;		// Abstractions of exhaustive failures, cleared when full
+	Plan_Cache_Stats stats;
+};
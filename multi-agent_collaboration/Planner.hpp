@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Environment.hpp"
+#include "Search.hpp"
 
 enum class Planner_Types {
 	MAC='m',
@@ -13,6 +14,10 @@ public:
 	Planner_Impl(Environment environment, Agent_Id planning_agent)
 		: environment(environment), planning_agent(planning_agent) {}
 	virtual Action get_next_action(const State& state, bool print_state) = 0;
+
+	// Searches of the latest get_next_action and of all calls so far, planners without searches report zeros
+	virtual Search_Stats get_step_search_stats() const { return {}; }
+	virtual Search_Stats get_search_stats() const { return {}; }
 protected:
 	Environment environment;
 	Agent_Id planning_agent;
@@ -27,6 +32,14 @@ public:
 		return planner_impl->get_next_action(state, print_state);
 	}
 
+	Search_Stats get_step_search_stats() const {
+		return planner_impl->get_step_search_stats();
+	}
+
+	Search_Stats get_search_stats() const {
+		return planner_impl->get_search_stats();
+	}
+
 private:
 	std::unique_ptr<Planner_Impl> planner_impl;
 };
\ No newline at end of file
@@ -6,92 +6,37 @@
 #include "State.hpp"
 #include "Recogniser.hpp"
 #include "Planner.hpp"
+#include "Plan_Cache.hpp"
+#include "Thread_Pool.hpp"
 
 #include <vector>
 #include <set>
 #include <algorithm> 
 #include <deque>
+#include <memory>
 
 struct Action_Path {
 	Action_Path(std::vector<Joint_Action> joint_actions,
 		const Goal goal,
 		const State& state_in,
 		const Environment& environment)
-		: joint_actions(joint_actions), recipe(goal.recipe), agents(goal.agents),
+		: Action_Path(joint_actions, goal, state_in, environment, {}) {}
+
+	// Takes first_action and last_action from the search when it recorded them, else replays the actions
+	Action_Path(std::vector<Joint_Action> joint_actions,
+		const Goal goal,
+		const State& state_in,
+		const Environment& environment,
+		const Handoff_Actions& handoff_actions)
+		: joint_actions(pack_joint_actions(joint_actions)), recipe(goal.recipe), agents(goal.agents),
 		handoff_agent(goal.handoff_agent),
 		first_action(EMPTY_VAL), last_action(EMPTY_VAL) {
 
-		//const auto& handoff_agent = goal.handoff_agent;
-
-		if (joint_actions.empty() || handoff_agent == EMPTY_VAL) {
-			return;
-		}
-		auto initial_coordinate = state_in.get_agent(handoff_agent).coordinate;
-		
-		// Stop at first action which interacts with a wall
-		first_action = 0;
-		auto coordinate = initial_coordinate;
-		while (true) {
-			auto direction = joint_actions.at(first_action).get_action(handoff_agent).direction;
-			auto coordinate_noclip = environment.move_noclip(coordinate, direction);
-
-			// New useful definition
-			if (environment.is_cell_type(coordinate_noclip, Cell_Type::WALL)) {
-				auto item = state_in.get_ingredient_at_position(coordinate_noclip);
-				auto agent_item = state_in.get_agent(handoff_agent).item;
-				if (item.has_value()
-					&& (item.value() == goal.recipe.ingredient1
-						|| item.value() == goal.recipe.ingredient2)) {
-					break;
-				} else if (agent_item.has_value()
-					&& (agent_item.value() == goal.recipe.ingredient1
-						|| agent_item.value() == goal.recipe.ingredient2)) {
-					break;
-				}
-			}
-
-			//if (environment.is_cell_type(coordinate, Cell_Type::WALL)) {
-			//	break;
-			//}
-			if (first_action == joint_actions.size() - 1) {
-				first_action = EMPTY_VAL;
-				break;
-			}
-			++first_action;
-			coordinate = environment.move(coordinate, direction);
-		}
-
-		// Note last action which interacts with a wall 
-		// (note wall check is using noclip, but coordinate tracking is using regular move)
-		coordinate = initial_coordinate;
-		last_action = EMPTY_VAL;
-		size_t action_counter = 0;
-		auto state = state_in;
-		while (action_counter < joint_actions.size()) {
-			bool result = environment.act(state, joint_actions.at(action_counter));
-			assert(result);
-			const auto& direction = joint_actions.at(action_counter).get_action(handoff_agent).direction;
-
-			// New useful definition
-			if (environment.is_cell_type(environment.move_noclip(coordinate, direction), Cell_Type::WALL)) {
-				auto item = state.get_ingredient_at_position(environment.move_noclip(coordinate, direction));
-				auto agent_item = state.get_agent(handoff_agent).item;
-				if (item.has_value()
-					&& (item.value() == goal.recipe.ingredient1
-						|| item.value() == goal.recipe.ingredient2)) {
-					last_action = action_counter;
-				} else if (agent_item.has_value()
-					&& (agent_item.value() == goal.recipe.ingredient1
-						|| agent_item.value() == goal.recipe.ingredient2)) {
-					last_action = action_counter;;
-				}
-			}
-			//if (environment.is_cell_type(environment.move_noclip(coordinate, direction), Cell_Type::WALL)) {
-			//	last_action = action_counter;
-			//}
-
-			coordinate = environment.move(coordinate, direction);
-			++action_counter;
+		if (handoff_actions.recorded) {
+			first_action = handoff_actions.first_action;
+			last_action = handoff_actions.last_action;
+		} else {
+			find_handoff_actions(joint_actions, goal, state_in, environment);
 		}
 	}
 
@@ -171,7 +116,85 @@ struct Action_Path {
 //		return false;
 //	}
 
-	std::vector<Joint_Action> joint_actions;
+	// Replays the actions to find the handoff agent's first and last useful wall interactions
+	void find_handoff_actions(const std::vector<Joint_Action>& joint_actions, const Goal& goal,
+		const State& state_in, const Environment& environment) {
+
+		//const auto& handoff_agent = goal.handoff_agent;
+
+		if (joint_actions.empty() || handoff_agent == EMPTY_VAL) {
+			return;
+		}
+		auto initial_coordinate = state_in.get_agent(handoff_agent).coordinate;
+		
+		// Stop at first action which interacts with a wall
+		first_action = 0;
+		auto coordinate = initial_coordinate;
+		while (true) {
+			auto direction = joint_actions.at(first_action).get_action(handoff_agent).direction;
+			auto coordinate_noclip = environment.move_noclip(coordinate, direction);
+
+			// New useful definition
+			if (environment.is_cell_type(coordinate_noclip, Cell_Type::WALL)) {
+				auto item = state_in.get_ingredient_at_position(coordinate_noclip);
+				auto agent_item = state_in.get_agent(handoff_agent).item;
+				if (item.has_value()
+					&& (item.value() == goal.recipe.ingredient1
+						|| item.value() == goal.recipe.ingredient2)) {
+					break;
+				} else if (agent_item.has_value()
+					&& (agent_item.value() == goal.recipe.ingredient1
+						|| agent_item.value() == goal.recipe.ingredient2)) {
+					break;
+				}
+			}
+
+			//if (environment.is_cell_type(coordinate, Cell_Type::WALL)) {
+			//	break;
+			//}
+			if (first_action == joint_actions.size() - 1) {
+				first_action = EMPTY_VAL;
+				break;
+			}
+			++first_action;
+			coordinate = environment.move(coordinate, direction);
+		}
+
+		// Note last action which interacts with a wall 
+		// (note wall check is using noclip, but coordinate tracking is using regular move)
+		coordinate = initial_coordinate;
+		last_action = EMPTY_VAL;
+		size_t action_counter = 0;
+		auto state = state_in;
+		while (action_counter < joint_actions.size()) {
+			bool result = environment.act(state, joint_actions.at(action_counter));
+			assert(result);
+			const auto& direction = joint_actions.at(action_counter).get_action(handoff_agent).direction;
+
+			// New useful definition
+			if (environment.is_cell_type(environment.move_noclip(coordinate, direction), Cell_Type::WALL)) {
+				auto item = state.get_ingredient_at_position(environment.move_noclip(coordinate, direction));
+				auto agent_item = state.get_agent(handoff_agent).item;
+				if (item.has_value()
+					&& (item.value() == goal.recipe.ingredient1
+						|| item.value() == goal.recipe.ingredient2)) {
+					last_action = action_counter;
+				} else if (agent_item.has_value()
+					&& (agent_item.value() == goal.recipe.ingredient1
+						|| agent_item.value() == goal.recipe.ingredient2)) {
+					last_action = action_counter;;
+				}
+			}
+			//if (environment.is_cell_type(environment.move_noclip(coordinate, direction), Cell_Type::WALL)) {
+			//	last_action = action_counter;
+			//}
+
+			coordinate = environment.move(coordinate, direction);
+			++action_counter;
+		}
+	}
+
+	std::vector<Packed_Joint_Action> joint_actions;
 	Recipe recipe;
 	Agent_Combination agents;
 	size_t first_action;	// First useful action by handoff_agent
@@ -180,82 +203,137 @@ struct Action_Path {
 	Agent_Id handoff_agent;
 };
 
+/**
+Action paths by goal, stored as a layer of its own goals over an optional shared base.
+Lookups fall through to the base for goals the layer does not hold. Copies share the
+layer and clone it on their first change, and with_update stacks a one-goal layer over
+a copy, so a re-search costs O(changed goals) instead of copying every path.
+*/
 struct Paths {
-	Paths() : handoff_map(), handoff_paths(){};
-
-	Paths(const Paths& other) {
-		for (const auto& [goal, path_ptr] : other.handoff_map) {
-			this->insert(goal, *path_ptr);
-		}
-	}
+	Paths() : layer(std::make_shared<Layer>()), base() {};
 
 	void insert(const Goal& goal, const Action_Path& path) {
-		handoff_paths.push_back(path);
-		handoff_map.insert({ goal, &handoff_paths.back() });
+		get_own_layer().insert(goal, path);
 	}
 	
 	void insert(const std::vector<Joint_Action>& actions, const Goal& goal,
-		const State& state, const Environment& environment) {
-
-		handoff_paths.push_back({ actions, goal, state, environment });
-		Action_Path* path_ptr = &handoff_paths.back();
-		handoff_map.insert({ goal, path_ptr });
+		const State& state, const Environment& environment, const Handoff_Actions& handoff_actions = {}) {
 
+		get_own_layer().insert(goal, { actions, goal, state, environment, handoff_actions });
 	}
 
-	void update(const std::vector<Joint_Action>& actions,
-		const Goal& goal, const State& state, const Environment& environment) {
+	void update(const std::vector<Joint_Action>& actions, const Goal& goal, 
+		const State& state, const Environment& environment, const Handoff_Actions& handoff_actions = {}) {
 
-		auto it = handoff_map.find(goal);
-		if (it == handoff_map.end()) {
-			insert(actions, goal, state, environment);
+		auto& own_layer = get_own_layer();
+		auto it = own_layer.handoff_map.find(goal);
+		if (it == own_layer.handoff_map.end()) {
+			own_layer.insert(goal, { actions, goal, state, environment, handoff_actions });
 		} else {
-			(*it->second) = Action_Path(actions, goal, state, environment);
+			(*it->second) = Action_Path(actions, goal, state, environment, handoff_actions);
 		}
 	}
 
-	const std::map<Goal, Action_Path*>& get_handoff() const {
-		return handoff_map;
+	// These paths with goal replaced, leaving this unchanged
+	Paths with_update(const std::vector<Joint_Action>& actions, const Goal& goal, 
+		const State& state, const Environment& environment, const Handoff_Actions& handoff_actions = {}) const {
+
+		Paths result;
+		result.base = std::make_shared<const Paths>(*this);
+		result.update(actions, goal, state, environment, handoff_actions);
+		return result;
+	}
+
+	// All goals, layers shadowing their base
+	std::map<Goal, const Action_Path*> get_handoff() const {
+		std::map<Goal, const Action_Path*> result;
+		if (base) {
+			result = base->get_handoff();
+		}
+		for (const auto& [goal, path_ptr] : layer->handoff_map) {
+			result[goal] = path_ptr;
+		}
+		return result;
 	}
 
 	std::optional<const Action_Path*> get_handoff(const Goal& goal) const { 
-		auto it = handoff_map.find(goal); 
-		if (it == handoff_map.end()) {
-			return {};
-		} else {
+		auto it = layer->handoff_map.find(goal); 
+		if (it != layer->handoff_map.end()) {
 			return it->second;
+		} else if (base) {
+			return base->get_handoff(goal);
+		} else {
+			return {};
 		}
 	}
 
 	bool empty() const {
-		return handoff_paths.empty();
+		return layer->handoff_paths.empty() && (!base || base->empty());
 	}
 
 private:
-	std::deque<Action_Path> handoff_paths;
-	std::map<Goal, Action_Path*> handoff_map;
+	struct Layer {
+		Layer() : handoff_paths(), handoff_map() {};
+
+		Layer(const Layer& other) : handoff_paths(), handoff_map() {
+			for (const auto& [goal, path_ptr] : other.handoff_map) {
+				insert(goal, *path_ptr);
+			}
+		}
+
+		void insert(const Goal& goal, const Action_Path& path) {
+			handoff_paths.push_back(path);
+			handoff_map.insert({ goal, &handoff_paths.back() });
+		}
+
+		std::deque<Action_Path> handoff_paths;
+		std::map<Goal, Action_Path*> handoff_map;
+	};
+
+	Layer& get_own_layer() {
+		if (layer.use_count() > 1) {
+			layer = std::make_shared<Layer>(*layer);
+		}
+		return *layer;
+	}
+
+	std::shared_ptr<Layer> layer;
+	std::shared_ptr<const Paths> base;
+};
+
+constexpr size_t DEFAULT_DEPTH_BOUND_SLACK = 3;	// Added to the expected plan length to bound a goal's first search
+
+// One unconstrained search issued by get_all_paths
+struct Goal_Search {
+	Goal_Search(const Goal& goal) 
+		: goal(goal), path(), cached(false), depth_bound(Search_Limits::UNLIMITED), exhaustive(false), stats(), handoff_actions() {}
+	Goal goal;
+	std::vector<Joint_Action> path;
+	bool cached;
+	size_t depth_bound;		// Initial bound, widened until the search succeeds or reaches the depth limit
+	bool exhaustive;		// Last search had no depth cutoffs
+	Search_Stats stats;		// Empty when cached, summed over widened searches
+	Handoff_Actions handoff_actions;	// Not recorded when cached
 };
 
+// Ordered handoff agents, one per goal. May repeat agents or hold EMPTY_VAL, so not Agent_Combinations
 struct Permutations {
-	Permutations(size_t max_size) : permutations(max_size, std::vector<Agent_Combination>()) {}
+	Permutations(size_t max_size) : permutations(max_size, std::vector<std::vector<Agent_Id>>()) {}
 
 	void insert(const std::vector<Agent_Id>& agents) {
-		permutations.at(agents.size() - 1).push_back(Agent_Combination(agents));
+		permutations.at(agents.size() - 1).push_back(agents);
 	}
 	void insert(const std::vector<std::vector<Agent_Id>>& agents_list) {
 		for (const auto& agents : agents_list) {
-			permutations.at(agents.size() - 1).push_back(Agent_Combination(agents));
+			permutations.at(agents.size() - 1).push_back(agents);
 		}
 	}
-	void insert(const Agent_Combination& agents) {
-		permutations.at(agents.size() - 1).push_back(agents);
-	}
 
-	const std::vector<Agent_Combination>& get(size_t size) {
+	const std::vector<std::vector<Agent_Id>>& get(size_t size) {
 		return permutations.at(size - 1);
 	}
 
-	std::vector<std::vector<Agent_Combination>> permutations;
+	std::vector<std::vector<std::vector<Agent_Id>>> permutations;
 };
 
 struct Collaboration_Info {
@@ -604,12 +682,43 @@ struct Goal_Agents {
 	Goal chosen_goal;
 };
 
+/**
+Per-step products which do not depend on the planning agent: reachability, the possible recipes,
+the paths of every goal and the recogniser fed with them. Planners given the same context compute
+them once per step, the first planner asked for a step computes them and the others reuse them.
+Planners sharing a context must be stepped together over the same states from one thread.
+*/
+struct Planning_Context {
+	Planning_Context(const Environment& environment, const State& initial_state);
+
+	bool is_current(size_t step, const State& state) const {
+		return this->step == step && this->state == state;
+	}
+
+	Recogniser recogniser;
+	std::map<std::pair<Agent_Id, Agent_Combination>, Reachables> agent_reachables;
+	std::vector<Recipe> recipes;
+	Paths paths;
+	size_t step;	// Call of get_next_action the products belong to, EMPTY_VAL before the first
+	State state;
+	std::unique_ptr<Thread_Pool> thread_pool;	// Created by the first planner to search, see get_thread_pool
+	std::vector<Search> worker_searches;		// Searches for pool workers 1.., worker 0 uses the planner's search
+};
+
 class Planner_Mac : public Planner_Impl {
 
 
 public:
-	Planner_Mac(Environment environment, Agent_Id agent, const State& initial_state, size_t seed=0);
+	// Planners given the same context share its per-step products and search threads, otherwise the planner has its own.
+	// step_budget caps the node expansions of each get_next_action, searches are skipped once
+	// it is spent. UNLIMITED for no cap.
+	// A goal's first search is bounded by the length of last step's plan for it, less the step taken, plus depth_bound_slack.
+	Planner_Mac(Environment environment, Agent_Id agent, const State& initial_state, size_t seed=0,
+		std::shared_ptr<Planning_Context> context = {}, size_t step_budget = Search_Limits::UNLIMITED,
+		size_t depth_bound_slack = DEFAULT_DEPTH_BOUND_SLACK);
 	virtual Action get_next_action(const State& state, bool print_state) override;
+	virtual Search_Stats get_step_search_stats() const override;
+	virtual Search_Stats get_search_stats() const override;
 
 private:
 
@@ -638,7 +747,7 @@ private:
 		const Paths& paths, const std::vector<std::vector<Agent_Id>>& agent_permutations,
 		const State& state);
 	std::vector<Collaboration_Info>			get_collaboration_permutations(const Goals& goals,
-		const Paths& paths, const std::vector<Agent_Combination>& agent_permutations,
+		const Paths& paths, const std::vector<std::vector<Agent_Id>>& agent_permutations,
 		const State& state);
 	Permutations							get_handoff_permutations() const;
 	std::optional<std::vector<Action_Path>> get_permutation_action_paths(const Goals& goals,
@@ -661,12 +770,22 @@ private:
 	bool									temp(const Agent_Combination& agents, const Agent_Id& handoff_agent, const Recipe& recipe, const State& state);
 	void									trim_trailing_non_actions(std::vector<Joint_Action>& joint_actions, 
 		const Agent_Id& handoff_agent);
+	void									update_context(const State& state);
 	void									update_recogniser(const Paths& paths, const State& state);
+	void									add_search_stats(const Search_Stats& stats);
+	Search_Limits							get_search_limits(size_t searches, size_t budget_divisor) const;
+	Thread_Pool&							get_thread_pool();
 
 
-	Recogniser recogniser;
 	Search search;
-	std::map<std::pair<Agent_Id, Agent_Combination>, Reachables> agent_reachables;
+	Plan_Cache plan_cache;
+	std::shared_ptr<Planning_Context> context;
 	std::map<Recipe_Agents, Solution_History> recipe_solutions;
+	Search_Stats step_search_stats;
+	Search_Stats total_search_stats;
 	size_t time_step;
+	size_t calls;	// Of get_next_action
+	size_t step_budget;
+	size_t remaining_budget;	// Of the current step
+	size_t depth_bound_slack;
 };
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "Recogniser.hpp"
 #include "Sliding_Recogniser.hpp"
 #include "Bayesian_Recogniser.hpp"
+#include "Trace.hpp"
 
 #include <chrono>
 #include <iostream>
@@ -26,31 +27,91 @@
 
 
 constexpr auto INITIAL_DEPTH_LIMIT = 30;
+constexpr auto PLAN_CACHE_CAPACITY = 2048;
 constexpr auto GAMMA = 1.01;
 constexpr auto GAMMA2 = 1.02;
+constexpr auto OPERATOR_DECOMPOSITION_AGENTS = 4;
+constexpr auto ANYTIME_WEIGHT = 2.0f;			// Heuristic weight of budgeted searches
+constexpr auto MIN_SEARCH_BUDGET = 100;			// Expansions of a budgeted search while enough is left
+constexpr auto ALL_PATHS_BUDGET_DIVISOR = 2;	// get_all_paths searches share half of what is left
+constexpr auto SEARCH_BUDGET_DIVISOR = 4;		// Later searches take a quarter each
+
+// Full expansion grows as 5^k successors, larger kitchens expand one agent at a time
+static Joint_Expansion get_joint_expansion(const Environment& environment) {
+	return environment.get_number_of_agents() >= OPERATOR_DECOMPOSITION_AGENTS 
+		? Joint_Expansion::OPERATOR_DECOMPOSITION : Joint_Expansion::FULL;
+}
 
-Planner_Mac_One::Planner_Mac_One(Environment environment, Agent_Id planning_agent, const State& initial_state, size_t seed)
+Planner_Mac_One::Planner_Mac_One(Environment environment, Agent_Id planning_agent, const State& initial_state, size_t seed,
+	std::shared_ptr<Planning_Context> context, size_t step_budget, size_t depth_bound_slack)
 	: Planner_Impl(environment, planning_agent), time_step(0),
-	search(std::make_unique<A_Star>(environment, INITIAL_DEPTH_LIMIT)),
-	recogniser(std::make_unique<Sliding_Recogniser>(environment, initial_state)) {
+	search(std::make_unique<A_Star>(environment, INITIAL_DEPTH_LIMIT, Heuristic_Cache_Scope::GOAL, 
+			get_joint_expansion(environment))),
+	plan_cache(environment, PLAN_CACHE_CAPACITY),
+	context(context ? context : std::make_shared<Planning_Context>(environment, initial_state)), calls(0),
+		step_budget(step_budget), remaining_budget(step_budget), depth_bound_slack(depth_bound_slack) {
 	set_random_seed(0);
 	initialize_reachables(initial_state);
 	initialize_solutions();
 }
 
+Search_Stats Planner_Mac_One::get_step_search_stats() const {
+	return step_search_stats;
+}
+
+Search_Stats Planner_Mac_One::get_search_stats() const {
+	return total_search_stats;
+}
+
+void Planner_Mac_One::add_search_stats(const Search_Stats& stats) {
+	step_search_stats += stats;
+	total_search_stats += stats;
+	if (step_budget != Search_Limits::UNLIMITED) {
+		remaining_budget -= std::min(remaining_budget, stats.expanded);
+	}
+}
+
+// Without a step budget searches stop at their first plan. With one they are anytime, and
+// searches together take 1/budget_divisor of what is left of the step budget, at least
+// MIN_SEARCH_BUDGET each but never more than what is left. A budget of 0 skips the search.
+Search_Limits Planner_Mac_One::get_search_limits(size_t searches, size_t budget_divisor) const {
+	if (step_budget == Search_Limits::UNLIMITED) {
+		return {};
+	}
+	searches = std::max<size_t>(searches, 1);
+	auto budget = std::min<size_t>(std::max<size_t>(MIN_SEARCH_BUDGET, remaining_budget / budget_divisor / searches), 
+		remaining_budget / searches);
+	return { Search_Limits::UNLIMITED, budget, ANYTIME_WEIGHT };
+}
+
+// Planners sharing a context take turns, so they can share one pool. It is created on
+// first use, a planner which never searches starts no threads.
+Thread_Pool& Planner_Mac_One::get_thread_pool() {
+	if (!context->thread_pool) {
+		context->thread_pool = std::make_unique<Thread_Pool>(Thread_Pool::default_thread_count());
+		for (size_t worker_index = 1; worker_index < context->thread_pool->size(); ++worker_index) {
+			context->worker_searches.emplace_back(std::make_unique<A_Star>(environment, INITIAL_DEPTH_LIMIT, 
+				Heuristic_Cache_Scope::GOAL, get_joint_expansion(environment)));
+		}
+	}
+	return *context->thread_pool;
+}
+
 Action Planner_Mac_One::get_next_action(const State& state, bool print_state) {
+	TRACE_SPAN_LABELLED("get_next_action", "agent " + std::to_string(planning_agent.id) + " step " + std::to_string(time_step));
 
 	if (print_state) environment.print_state(state);
+	step_search_stats = {};
+	remaining_budget = step_budget;
 	PRINT(Print_Category::PLANNER, Print_Level::DEBUG, std::string("Time step: ") + std::to_string(time_step) + "\n");
 
-	initialize_reachables(state);
-	auto recipes = environment.get_possible_recipes(state);
+	update_context(state);
+	const auto& recipes = context->recipes;
 	if (recipes.empty()) {
 		return { Direction::NONE, { planning_agent } };
 	}
-	auto paths = get_all_paths(recipes, state);
-	update_recogniser(paths, state);
-	recogniser.print_probabilities();
+	auto paths = context->paths;
+	context->recogniser.print_probabilities();
 
 	auto infos = calculate_infos(paths, recipes, state);
 	if (infos.empty()) {
@@ -62,7 +123,6 @@ Action Planner_Mac_One::get_next_action(const State& state, bool print_state) {
 	size_t max_tasks = environment.get_number_of_agents();
 	auto info = get_best_collaboration(infos, probable_infos, state);
 
-	std::stringstream buffer3;
 	++time_step;
 	Action result_action{};
 	if (info.has_value()
@@ -72,10 +132,10 @@ Action Planner_Mac_One::get_next_action(const State& state, bool print_state) {
 		//result_action = info.next_action;
 	}
 
+	PRINT(Print_Category::PLANNER, Print_Level::DEBUG, step_search_stats.to_string() + "\n");
 	if (info.has_value()) {
-		buffer3 << "Agent " << planning_agent.id << " chose " << info.to_string() << " action "
-			<< result_action.to_string() << "\n";
-		PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer3.str());
+		PRINT(Print_Category::PLANNER, Print_Level::DEBUG, "Agent " + std::to_string(planning_agent.id) 
+			+ " chose " + info.to_string() + " action " + result_action.to_string() + "\n");
 		return result_action;
 
 		//if (info.has_value()) {
@@ -84,13 +144,14 @@ Action Planner_Mac_One::get_next_action(const State& state, bool print_state) {
 		//	PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer3.str());
 		//	return info.next_action;
 	} else {
-		buffer3 << "Agent " << planning_agent.id << " did not find relevant action\n";
-		PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer3.str());
+		PRINT(Print_Category::PLANNER, Print_Level::DEBUG, "Agent " + std::to_string(planning_agent.id) 
+			+ " did not find relevant action\n");
 		return Action{ Direction::NONE, {planning_agent } };
 	}
 }
 
 Action Planner_Mac_One::get_random_good_action(const Collaboration_Info& info, const Paths& paths_in, const State& state) {
+	TRACE_SPAN("get_random_good_action");
 
 	auto& goals = info.get_goals();
 
@@ -201,8 +262,12 @@ Action Planner_Mac_One::get_random_good_action(const Collaboration_Info& info, c
 		}
 	}
 
+	// Keep the chosen action when the step budget ran out before any action was searched
+	if (result_actions.empty()) {
+		return info.next_action;
+	}
 	auto result_action = get_random<Action>(result_actions);
-	if (result_action != info.next_action) {
+	if (result_action != info.next_action && is_print_allowed(Print_Category::PLANNER, Print_Level::DEBUG)) {
 		std::stringstream buffer;
 		buffer << "Changed from " << info.next_action.to_string() << " to " << result_action.to_string() << " for goal " << info.chosen_goal.to_string() << "\n";
 		PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer.str());
@@ -212,6 +277,7 @@ Action Planner_Mac_One::get_random_good_action(const Collaboration_Info& info, c
 
 std::vector<Collaboration_Info> Planner_Mac_One::calculate_infos(const Paths& paths, const std::vector<Recipe>& recipes_in,
 	const State& state) {
+	TRACE_SPAN("calculate_infos");
 	size_t total_agents = environment.get_number_of_agents();
 
 	// Precalculate all recipe combinations
@@ -277,7 +343,7 @@ Permutations Planner_Mac_One::get_handoff_permutations() const {
 
 	// None-handoff for single agent
 	if (min_index > -1) {
-		result.insert(Agent_Combination(Agent_Id(EMPTY_VAL)));
+		result.insert(std::vector<Agent_Id>{ Agent_Id(EMPTY_VAL) });
 	}
 
 	for (size_t current_size = 1; current_size <= max_size; ++current_size) {
@@ -316,6 +382,8 @@ Permutations Planner_Mac_One::get_handoff_permutations() const {
 
 std::vector<Collaboration_Info> Planner_Mac_One::calculate_probable_multi_goals(const std::vector<Collaboration_Info>& infos,
 	const std::map<Goals, float>& goal_values, const State& state) {
+	TRACE_SPAN("calculate_probable_multi_goals");
+	const bool print_values = is_print_allowed(Print_Category::PLANNER, Print_Level::DEBUG);
 	std::vector<bool> are_probable;
 	std::stringstream buffer1;
 	std::stringstream buffer2;
@@ -327,7 +395,9 @@ std::vector<Collaboration_Info> Planner_Mac_One::calculate_probable_multi_goals(
 	for (auto& info_entry : infos) {
 		bool is_probable = true;
 		bool is_coop_better = true;
-		buffer1 << info_entry.to_string() << "\t";
+		if (print_values) {
+			buffer1 << info_entry.to_string() << "\t";
+		}
 
 		if (info_entry.agents_size() > 1) {
 
@@ -384,7 +454,7 @@ std::vector<Collaboration_Info> Planner_Mac_One::calculate_probable_multi_goals(
 				for (const auto& agent : goal.agents) {
 					//bool use_non_probability = agent != planning_agent;
 					bool use_non_probability = (agent != planning_agent || info_entry.goals_size() > 1);
-					if (recogniser.is_probable_normalised(goal, normalisation_goals, agent, planning_agent, use_non_probability)) {
+					if (context->recogniser.is_probable_normalised(goal, normalisation_goals, agent, planning_agent, use_non_probability)) {
 						inner_probable = true;
 						break;
 					}
@@ -395,7 +465,9 @@ std::vector<Collaboration_Info> Planner_Mac_One::calculate_probable_multi_goals(
 			}
 
 		}
-		buffer2 << (is_probable ? "" : "X") << info_entry.value << "\t";
+		if (print_values) {
+			buffer2 << (is_probable ? "" : "X") << info_entry.value << "\t";
+		}
 	}
 
 	// Copy probable infos
@@ -427,6 +499,7 @@ bool Planner_Mac_One::is_agent_subset_faster(const Collaboration_Info& info, con
 }
 
 std::map<Goals, float> Planner_Mac_One::calculate_goal_values(std::vector<Collaboration_Info>& infos) {
+	TRACE_SPAN("calculate_goal_values");
 	std::map<Goals, float> goal_values;
 	for (auto& entry : infos) {
 		//auto penalty = std::pow(GAMMA, entry.agents_size() - entry.goals_size());
@@ -529,7 +602,7 @@ std::pair<std::vector<Action>, Goal> Planner_Mac_One::get_actions_from_permutati
 	if (result_path == nullptr) {
 		float highest_prob = 0.0f;
 		for (const auto& goal : goals) {
-			auto probability = recogniser.get_probability(goal);
+			auto probability = context->recogniser.get_probability(goal);
 			auto path_opt = paths.get_handoff(goal);
 			auto path = path_opt.value();
 
@@ -810,7 +883,7 @@ std::optional<std::vector<Action_Path>> Planner_Mac_One::get_permutation_action_
 }
 
 std::vector<Collaboration_Info> Planner_Mac_One::get_collaboration_permutations(const Goals& goals_in,
-	const Paths& paths, const std::vector<Agent_Combination>& agent_permutations,
+	const Paths& paths, const std::vector<std::vector<Agent_Id>>& agent_permutations,
 	const State& state) {
 
 	std::vector<Collaboration_Info> infos;
@@ -818,7 +891,7 @@ std::vector<Collaboration_Info> Planner_Mac_One::get_collaboration_permutations(
 	// Get info on each permutation
 	for (const auto& agent_permutation : agent_permutations) {
 		if (goals_in.get_agents().size() == 1) {
-			if (agent_permutation != Agent_Combination(Agent_Id(EMPTY_VAL))) {
+			if (agent_permutation != std::vector<Agent_Id>{ Agent_Id(EMPTY_VAL) }) {
 				continue;
 			}
 		} else {
@@ -912,15 +985,25 @@ Paths Planner_Mac_One::perform_new_search(const State& state, const Goal& goal,
 	const std::vector<Joint_Action>& joint_actions, const Agent_Combination& acting_agents, const Action& initial_action) {
 
 
-	auto new_path = search.search_joint(state, goal.recipe, goal.agents, goal.handoff_agent, joint_actions, acting_agents, initial_action);
+	Search_Stats stats;
+	auto limits = get_search_limits(1, SEARCH_BUDGET_DIVISOR);
+	if (limits.expansion_budget == 0) {
+		++stats.budget_skips;
+		add_search_stats(stats);
+		return {};
+	}
+	Handoff_Actions handoff_actions;
+	auto new_path = search.search_joint(state, goal.recipe, goal.agents, goal.handoff_agent, joint_actions, acting_agents, initial_action, 
+		&stats, &handoff_actions, limits);
+	add_search_stats(stats);
 	if (new_path.empty()) {
 		return {};
 	}
 	Search_Trimmer trim;
-	trim.trim_forward(new_path, state, environment, goal.recipe);
-	auto new_paths = paths;
-	new_paths.update(new_path, goal, state, environment);
-	return new_paths;
+	if (trim.trim_forward(new_path, state, environment, goal.recipe)) {
+		handoff_actions = {};
+	}
+	return paths.with_update(new_path, goal, state, environment, handoff_actions);
 }
 
 void Planner_Mac_One::trim_trailing_non_actions(std::vector<Joint_Action>& joint_actions, const Agent_Id& handoff_agent) {
@@ -952,6 +1035,7 @@ void Planner_Mac_One::trim_trailing_non_actions(std::vector<Joint_Action>& joint
 
 Collaboration_Info Planner_Mac_One::get_best_collaboration(const std::vector<Collaboration_Info>& infos,
 	const std::vector<Collaboration_Info>& probable_infos, const State& state) {
+	TRACE_SPAN("get_best_collaboration");
 
 	//auto infos_copy = infos;
 	//std::sort(infos_copy.begin(), infos_copy.end(), [](const Collaboration_Info& lhs, const Collaboration_Info& rhs) {
@@ -1163,7 +1247,9 @@ bool Planner_Mac_One::temp(const Agent_Combination& agents, const Agent_Id& hand
 }
 
 Paths Planner_Mac_One::get_all_paths(const std::vector<Recipe>& recipes, const State& state) {
+	TRACE_SPAN("get_all_paths");
 	Paths paths;
+	std::vector<Goal_Search> goal_searches;
 	auto agent_combinations = get_combinations(environment.get_number_of_agents());
 
 	auto recipe_size = recipes.size();
@@ -1190,11 +1276,11 @@ Paths Planner_Mac_One::get_all_paths(const std::vector<Recipe>& recipes, const S
 			}
 
 
-			Agent_Combination handoff_agents;
+			std::vector<Agent_Id> handoff_agents;
 			if (agents.size() > 1) {
-				handoff_agents.add(agents);
+				handoff_agents = agents.get();
 			} else {
-				handoff_agents.add(Agent_Id(EMPTY_VAL));
+				handoff_agents.push_back(Agent_Id(EMPTY_VAL));
 			}
 
 			for (const auto& handoff_agent : handoff_agents) {
@@ -1227,44 +1313,135 @@ Paths Planner_Mac_One::get_all_paths(const std::vector<Recipe>& recipes, const S
 					//}
 				}
 
-				auto time_start = std::chrono::system_clock::now();
-				auto path = search.search_joint(state, recipe, agents, handoff_agent, {}, {}, {});
-				auto time_end = std::chrono::system_clock::now();
-				auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(time_end - time_start).count();
+				goal_searches.emplace_back(Goal(agents, recipe, handoff_agent));
+			}
+		}
+	}
 
-				Goal goal(agents, recipe, handoff_agent);
-				Action_Path a_path{ path, goal, state, environment };
+	// Searches are independent, run the uncached ones in parallel. Last step's plan for 
+	// the same goal bounds the search, the team usually followed it.
+	auto previous_paths = context->paths.get_handoff();
+	std::vector<size_t> uncached;
+	Search_Stats cache_stats;
+	auto infeasible_hits = plan_cache.get_stats().infeasible_hits;
+	for (size_t i = 0; i < goal_searches.size(); ++i) {
+		auto& goal_search = goal_searches.at(i);
+		auto cached_path = plan_cache.get(state, goal_search.goal);
+		if (cached_path.has_value()) {
+			goal_search.path = std::move(cached_path.value());
+			goal_search.cached = true;
+			++cache_stats.cache_skips;
+		} else {
+			auto previous_path = previous_paths.find(goal_search.goal);
+			if (previous_path != previous_paths.end()) {
+				goal_search.depth_bound = std::max<size_t>(previous_path->second->size(), 1) - 1 + depth_bound_slack;
+			}
+			uncached.push_back(i);
+		}
+	}
+	cache_stats.infeasible_hits = plan_cache.get_stats().infeasible_hits - infeasible_hits;
+	add_search_stats(cache_stats);
+	auto limits = get_search_limits(uncached.size(), ALL_PATHS_BUDGET_DIVISOR);
+	if (limits.expansion_budget == 0) {
+		for (auto i : uncached) {
+			++goal_searches.at(i).stats.budget_skips;
+		}
+		uncached.clear();
+	}
+	get_thread_pool().run(uncached.size(), [&](size_t task_index, size_t worker_index) {
+		auto& goal_search = goal_searches.at(uncached.at(task_index));
+		const auto& goal = goal_search.goal;
+		auto& worker_search = worker_index == 0 ? search : context->worker_searches.at(worker_index - 1);
+		TRACE_SPAN_LABELLED("search_joint", goal.to_string());
+
+		// A bounded search expands the same nodes as an unbounded one until it runs out of nodes below 
+		// the bound, so widening until success returns the plan the unbounded search would.
+		// Widened searches share the expansion budget of the goal.
+		auto search_limits = limits;
+		search_limits.depth_bound = std::min<size_t>(goal_search.depth_bound, INITIAL_DEPTH_LIMIT);
+		while (true) {
+			Search_Stats stats;
+			if (limits.is_anytime()) {
+				search_limits.expansion_budget = limits.expansion_budget 
+					- std::min(limits.expansion_budget, goal_search.stats.expanded);
+			}
+			goal_search.path = worker_search.search_joint(state, goal.recipe, goal.agents, goal.handoff_agent, {}, {}, {}, 
+				&stats, &goal_search.handoff_actions, search_limits);
+			goal_search.stats += stats;
+			goal_search.exhaustive = stats.depth_cutoffs == 0 && stats.budget_stops == 0;
+			if (!goal_search.path.empty() || goal_search.exhaustive || stats.budget_stops != 0 
+				|| search_limits.depth_bound == INITIAL_DEPTH_LIMIT) {
+				break;
+			}
+			search_limits.depth_bound = std::min<size_t>(search_limits.depth_bound * 2, INITIAL_DEPTH_LIMIT);
+		}
+	});
+
+	// Merge in enumeration order so the result does not depend on the thread count
+	for (auto& goal_search : goal_searches) {
+		const auto& goal = goal_search.goal;
+		auto& path = goal_search.path;
+		if (!goal_search.cached) {
 
+			// A plan cut short by the budget may not be the one an unlimited search returns
+			if (goal_search.stats.budget_stops == 0 && goal_search.stats.budget_skips == 0) {
+				plan_cache.insert(state, goal, path, goal_search.exhaustive);
+			}
+			add_search_stats(goal_search.stats);
+		}
 
-				std::stringstream buffer;
-				buffer << agents.to_string() << "/"
-					<< handoff_agent.to_string() << " : "
-					<< a_path.size() << " ("
-					<< a_path.first_action_string() << "-"
-					<< a_path.last_action_string() << ") : "
-					<< recipe.result_char() << " : "
-					<< diff << std::endl;
-				PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer.str());
+		if (is_print_allowed(Print_Category::PLANNER, Print_Level::DEBUG)) {
+			Action_Path a_path{ path, goal, state, environment, goal_search.handoff_actions };
+			std::stringstream buffer;
+			buffer << goal.agents.to_string() << "/"
+				<< goal.handoff_agent.to_string() << " : "
+				<< a_path.size() << " ("
+				<< a_path.first_action_string() << "-"
+				<< a_path.last_action_string() << ") : "
+				<< goal.recipe.result_char() << " : "
+				<< goal_search.stats.time_us / 1000 << std::endl;
+			PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer.str());
+		}
 
-				if (!path.empty()) {
+		if (!path.empty()) {
 
-					Search_Trimmer trim;
-					trim.trim_forward(path, state, environment, recipe);
-					//trim.trim(trim_path, state, environment, recipe);
-					paths.insert(path, goal, state, environment);
-				}
+			Search_Trimmer trim;
+			if (trim.trim_forward(path, state, environment, goal.recipe)) {
+				goal_search.handoff_actions = {};
 			}
+			//trim.trim(trim_path, state, environment, recipe);
+			paths.insert(path, goal, state, environment, goal_search.handoff_actions);
 		}
 	}
+	PRINT(Print_Category::PLANNER, Print_Level::DEBUG, plan_cache.get_stats().to_string() + "\n");
 	return paths;
 }
 
+// Computes the agent independent products of this step, unless a planner sharing the context already did
+void Planner_Mac_One::update_context(const State& state) {
+	auto step = calls++;
+	if (context->is_current(step, state)) {
+		return;
+	}
+	context->step = step;
+	context->state = state;
+	initialize_reachables(state);
+	context->recipes = environment.get_possible_recipes(state);
+	if (context->recipes.empty()) {
+		context->paths = {};
+		return;
+	}
+	context->paths = get_all_paths(context->recipes, state);
+	update_recogniser(context->paths, state);
+}
+
 void Planner_Mac_One::update_recogniser(const Paths& paths, const State& state) {
+	TRACE_SPAN("update_recogniser");
 	std::map<Goal, size_t> goal_lengths;
 	for (const auto& [goal, path] : paths.get_handoff()) {
 		goal_lengths.insert({ goal, path->size() });
 	}
-	recogniser.update(goal_lengths, state);
+	context->recogniser.update(goal_lengths, state);
 }
 bool Planner_Mac_One::ingredients_reachable(const Recipe& recipe, const Agent_Id agent, const Agent_Combination& agents, const State& state) const {
 	if (!ingredient_reachable(recipe.ingredient1, agent, agents, state)) return false;
@@ -1272,8 +1449,8 @@ bool Planner_Mac_One::ingredients_reachable(const Recipe& recipe, const Agent_Id
 }
 
 bool Planner_Mac_One::ingredient_reachable(const Ingredient& ingredient_in, const Agent_Id agent, const Agent_Combination& agents, const State& state) const {
-	auto reachables = agent_reachables.find({ agent, agents });
-	if (reachables == agent_reachables.end()) {
+	auto reachables = context->agent_reachables.find({ agent, agents });
+	if (reachables == context->agent_reachables.end()) {
 		throw std::runtime_error("Unknown agent combination");
 
 	}
@@ -1293,13 +1470,14 @@ bool Planner_Mac_One::ingredient_reachable(const Ingredient& ingredient_in, cons
 
 
 void Planner_Mac_One::initialize_reachables(const State& state) {
-	agent_reachables.clear();
+	TRACE_SPAN("initialize_reachables");
+	context->agent_reachables.clear();
 	std::vector<size_t> all_agents;
-	for (size_t i = 0; i < state.agents.size(); ++i) {
+	for (size_t i = 0; i < state.get_number_of_agents(); ++i) {
 		all_agents.push_back(i);
 	}
 
-	for (size_t agent = 0; agent < state.agents.size(); ++agent) {
+	for (size_t agent = 0; agent < state.get_number_of_agents(); ++agent) {
 		auto reduced_agents = all_agents;
 		reduced_agents.erase(reduced_agents.begin() + agent);
 
@@ -1335,7 +1513,7 @@ void Planner_Mac_One::initialize_reachables(const State& state) {
 					}
 				}
 			}
-			agent_reachables.insert({ {agent, agents}, reachables });
+			context->agent_reachables.insert({ {agent, agents}, reachables });
 		}
 	}
 }
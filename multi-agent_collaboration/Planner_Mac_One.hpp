@@ -17,8 +17,16 @@ class Planner_Mac_One : public Planner_Impl {
 
 
 public:
-	Planner_Mac_One(Environment environment, Agent_Id agent, const State& initial_state, size_t seed = 0);
+	// Planners given the same context share its per-step products, otherwise the planner has its own.
+	// step_budget caps the node expansions of each get_next_action, searches are skipped once
+	// it is spent. UNLIMITED for no cap.
+	// A goal's first search is bounded by the length of last step's plan for it, less the step taken, plus depth_bound_slack.
+	Planner_Mac_One(Environment environment, Agent_Id agent, const State& initial_state, size_t seed = 0,
+		std::shared_ptr<Planning_Context> context = {}, size_t step_budget = Search_Limits::UNLIMITED,
+		size_t depth_bound_slack = DEFAULT_DEPTH_BOUND_SLACK);
 	virtual Action get_next_action(const State& state, bool print_state) override;
+	virtual Search_Stats get_step_search_stats() const override;
+	virtual Search_Stats get_search_stats() const override;
 
 private:
 
@@ -47,7 +55,7 @@ private:
 		const Paths& paths, const std::vector<std::vector<Agent_Id>>& agent_permutations,
 		const State& state);
 	std::vector<Collaboration_Info>			get_collaboration_permutations(const Goals& goals,
-		const Paths& paths, const std::vector<Agent_Combination>& agent_permutations,
+		const Paths& paths, const std::vector<std::vector<Agent_Id>>& agent_permutations,
 		const State& state);
 	Permutations							get_handoff_permutations() const;
 	std::optional<std::vector<Action_Path>> get_permutation_action_paths(const Goals& goals,
@@ -70,12 +78,22 @@ private:
 	bool									temp(const Agent_Combination& agents, const Agent_Id& handoff_agent, const Recipe& recipe, const State& state);
 	void									trim_trailing_non_actions(std::vector<Joint_Action>& joint_actions,
 		const Agent_Id& handoff_agent);
+	void									update_context(const State& state);
 	void									update_recogniser(const Paths& paths, const State& state);
+	void									add_search_stats(const Search_Stats& stats);
+	Search_Limits							get_search_limits(size_t searches, size_t budget_divisor) const;
+	Thread_Pool&							get_thread_pool();
 
 
-	Recogniser recogniser;
 	Search search;
-	std::map<std::pair<Agent_Id, Agent_Combination>, Reachables> agent_reachables;
+	Plan_Cache plan_cache;
+	std::shared_ptr<Planning_Context> context;
 	std::map<Recipe_Agents, Solution_History> recipe_solutions;
+	Search_Stats step_search_stats;
+	Search_Stats total_search_stats;
 	size_t time_step;
+	size_t calls;	// Of get_next_action
+	size_t step_budget;
+	size_t remaining_budget;	// Of the current step
+	size_t depth_bound_slack;
 };
\ No newline at end of file
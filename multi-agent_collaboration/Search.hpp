@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <limits>
 #include <memory>
+#include <string>
 #include "Environment.hpp"
 #include "State.hpp"
 
@@ -55,12 +58,118 @@ namespace std {
 	};
 }
 
+// What one or more search_joint calls did. Everything but time_us is deterministic,
+// adding stats sums the counts and keeps the largest peaks.
+struct Search_Stats {
+	Search_Stats() : searches(0), generated(0), expanded(0), duplicates_merged(0), stale_pops(0), 
+		depth_cutoffs(0), dead_ends(0), heuristic_calls(0), heuristic_cache_hits(0), intermediate(0), improvements(0), 
+		budget_stops(0), budget_skips(0), cache_skips(0), infeasible_hits(0), peak_frontier(0), peak_visited(0), time_us(0) {}
+	size_t searches;
+	size_t generated;			// Successor nodes produced by valid actions
+	size_t expanded;			// Nodes taken off the frontier and expanded
+	size_t duplicates_merged;	// Successors of an already visited state
+	size_t stale_pops;			// Frontier pops of closed or replaced nodes, or of nodes that cannot beat the anytime plan
+	size_t depth_cutoffs;		// Frontier pops dropped by the depth limit
+	size_t dead_ends;			// Frontier pops dropped because the goal is unreachable from them
+	size_t heuristic_calls;		// Heuristic values computed
+	size_t heuristic_cache_hits;	// Heuristic values served from the cache
+	size_t intermediate;		// Operator decomposition nodes with only some agents' actions, not in generated
+	size_t improvements;		// Anytime plans replaced by a cheaper one
+	size_t budget_stops;		// Searches stopped by their expansion budget
+	size_t budget_skips;		// Searches not run because the step budget was spent
+	size_t cache_skips;			// Searches not run because the plan cache had the result
+	size_t infeasible_hits;		// Of those, answered by an exhaustive failure in an equivalent state
+	size_t peak_frontier;
+	size_t peak_visited;
+	long long time_us;
+
+	Search_Stats& operator+=(const Search_Stats& other) {
+		searches += other.searches;
+		generated += other.generated;
+		expanded += other.expanded;
+		duplicates_merged += other.duplicates_merged;
+		stale_pops += other.stale_pops;
+		depth_cutoffs += other.depth_cutoffs;
+		dead_ends += other.dead_ends;
+		heuristic_calls += other.heuristic_calls;
+		heuristic_cache_hits += other.heuristic_cache_hits;
+		intermediate += other.intermediate;
+		improvements += other.improvements;
+		budget_stops += other.budget_stops;
+		budget_skips += other.budget_skips;
+		cache_skips += other.cache_skips;
+		infeasible_hits += other.infeasible_hits;
+		peak_frontier = std::max(peak_frontier, other.peak_frontier);
+		peak_visited = std::max(peak_visited, other.peak_visited);
+		time_us += other.time_us;
+		return *this;
+	}
+
+	std::string to_string() const {
+		return "Search stats: " + std::to_string(searches) + " searches, "
+			+ std::to_string(generated) + " generated, "
+			+ std::to_string(expanded) + " expanded, "
+			+ std::to_string(duplicates_merged) + " duplicates, "
+			+ std::to_string(stale_pops) + " stale, "
+			+ std::to_string(depth_cutoffs) + " cutoffs, "
+			+ std::to_string(dead_ends) + " dead ends, "
+			+ std::to_string(heuristic_calls) + " heuristic calls, "
+			+ std::to_string(heuristic_cache_hits) + " heuristic cache hits, "
+			+ std::to_string(intermediate) + " intermediate, "
+			+ std::to_string(improvements) + " improvements, "
+			+ std::to_string(budget_stops) + " budget stops, "
+			+ std::to_string(budget_skips) + " budget skips, "
+			+ std::to_string(cache_skips) + " cache skips, "
+			+ std::to_string(infeasible_hits) + " infeasible hits, peak frontier "
+			+ std::to_string(peak_frontier) + ", peak visited "
+			+ std::to_string(peak_visited) + ", "
+			+ std::to_string(time_us) + " us";
+	}
+};
+
+// Handoff agent's first and last useful wall interactions in a returned plan, as defined
+// by Action_Path. Only valid when recorded, searches which do not track them leave it unset.
+struct Handoff_Actions {
+	Handoff_Actions() : first_action(EMPTY_VAL), last_action(EMPTY_VAL), recorded(false) {}
+	Handoff_Actions(size_t first_action, size_t last_action) 
+		: first_action(first_action), last_action(last_action), recorded(true) {}
+	size_t first_action;
+	size_t last_action;
+	bool recorded;
+};
+
+/**
+Limits of a single search. With an expansion budget the search is anytime: it orders the
+frontier by g + weight * h to find a first plan quickly, then keeps expanding nodes which could
+lead to a cheaper plan until the budget runs out, and returns the cheapest plan found.
+*/
+struct Search_Limits {
+	static constexpr size_t UNLIMITED = std::numeric_limits<size_t>::max();
+
+	Search_Limits() : depth_bound(UNLIMITED), expansion_budget(UNLIMITED), weight(1.0f) {}
+	Search_Limits(size_t depth_bound, size_t expansion_budget, float weight)
+		: depth_bound(depth_bound), expansion_budget(expansion_budget), weight(weight) {}
+
+	size_t depth_bound;			// Tightens depth_limit, a failure with depth cutoffs may succeed with a wider bound
+	size_t expansion_budget;	// UNLIMITED to stop at the first plan
+	float weight;				// Heuristic weight, only used with a budget
+
+	bool is_anytime() const {
+		return expansion_budget != UNLIMITED;
+	}
+};
+
 class Search_Method {
 public:
 	Search_Method(const Environment& environment, size_t depth_limit) : environment(environment), depth_limit(depth_limit) {}
+
+	// stats, if given, is overwritten with the statistics of this search,
+	// handoff_actions with the handoff interactions of the plan if the method records them.
+	// Methods may ignore limits they do not support.
 	virtual std::vector<Joint_Action> search_joint(const State& state,
 		Recipe recipe, const Agent_Combination& agents, Agent_Id handoff_agent,
-		const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents, const Action& initial_action) = 0;
+		const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents, const Action& initial_action,
+		Search_Stats* stats = nullptr, Handoff_Actions* handoff_actions = nullptr, const Search_Limits& limits = {}) = 0;
 	virtual std::pair<size_t, Direction> get_dist_direction(Coordinate source, Coordinate dest, size_t walls) = 0;
 protected:
 		template<typename T>
@@ -76,9 +185,11 @@ public:
 	Search(std::unique_ptr<Search_Method> search_method) : search_method(std::move(search_method)) {};
 	std::vector<Joint_Action> search_joint(const State& state, Recipe recipe, const Agent_Combination& agents, 
 		Agent_Id handoff_agent, const std::vector<Joint_Action>& input_actions, 
-		const Agent_Combination& free_agents, const Action& initial_action) {
+		const Agent_Combination& free_agents, const Action& initial_action, Search_Stats* stats = nullptr,
+		Handoff_Actions* handoff_actions = nullptr, const Search_Limits& limits = {}) {
 		
-		return search_method->search_joint(state, recipe, agents, handoff_agent, input_actions, free_agents, initial_action);
+		return search_method->search_joint(state, recipe, agents, handoff_agent, input_actions, free_agents, initial_action, 
+			stats, handoff_actions, limits);
 	}
 	std::pair<size_t, Direction> get_dist_direction(Coordinate source, Coordinate dest, size_t walls) {
 		return search_method->get_dist_direction(source, dest, walls);
@@ -39,30 +39,65 @@ std::vector<Joint_Action> Search_Trimmer::apply_modified_actions(size_t start_in
 	return modified_actions;
 }
 
-void Search_Trimmer::trim_forward(std::vector<Joint_Action>& actions, const State& state, const Environment& environment, const Recipe& recipe) const {
+/*
+Equivalent to trying every (action_index, agent) pair from the back, re-simulating the prefix with the
+agent idle each time. The prefix up to action_index with the agent idle is a prefix of the whole plan
+with the agent idle, so one pass per agent answers every action_index. The passes are only redone
+when an agent is trimmed and the plan changes, at most once per agent.
+*/
+bool Search_Trimmer::trim_forward(std::vector<Joint_Action>& actions, const State& state, const Environment& environment, const Recipe& recipe) const {
 
-	std::vector<bool> agent_done;
-	for (size_t agent = 0; agent < environment.get_number_of_agents(); ++agent) {
-		agent_done.push_back(false);
-	}
+	auto number_of_agents = environment.get_number_of_agents();
+	std::vector<bool> agent_done(number_of_agents, false);
+	std::vector<std::vector<bool>> result_steps(number_of_agents);
 
-
-	State baseline_state = state;
 	bool done = false;
+	bool changed = false;
 	for (int action_index = actions.size()-1; action_index >= 0 && !done; --action_index) {
-		for (size_t agent = 0; agent < environment.get_number_of_agents(); ++agent) {
+		for (size_t agent = 0; agent < number_of_agents; ++agent) {
 			if (agent_done.at(agent)) continue;
-			State current_state = baseline_state;
 
-			auto modified_actions = apply_modified_actions(0, action_index, agent, current_state, environment, actions);
+			auto& agent_result_steps = result_steps.at(agent);
+			if (agent_result_steps.empty()) {
+				agent_result_steps = get_result_steps(agent, state, environment, recipe, actions);
+			}
 
-			if (current_state.contains_item(recipe.result)) {
-				actions = modified_actions;
+			if (agent_result_steps.at(action_index)) {
+				bool modified = false;
+				for (int index = 0; index <= action_index; ++index) {
+					auto& joint_action = actions.at(index);
+					if (joint_action.get_action(agent).direction != Direction::NONE) {
+						joint_action.update_action(agent, Direction::NONE);
+						modified = true;
+					}
+				}
+				if (modified) {
+					changed = true;
+					for (auto& steps : result_steps) {
+						steps.clear();
+					}
+				}
 				agent_done.at(agent) = true;
 
-				done |= (std::count(agent_done.begin(), agent_done.end(), true) == environment.get_number_of_agents() - 1);
+				done |= (static_cast<size_t>(std::count(agent_done.begin(), agent_done.end(), true)) == number_of_agents - 1);
 			}
 		}
-		//environment.act(baseline_state, actions.at(action_index), Print_Level::NOPE);
 	}
+	return changed;
+}
+
+std::vector<bool> Search_Trimmer::get_result_steps(size_t agent, const State& state, const Environment& environment, 
+	const Recipe& recipe, std::vector<Joint_Action>& actions) const {
+
+	std::vector<bool> result;
+	result.reserve(actions.size());
+	State current_state = state;
+	for (auto& joint_action : actions) {
+		auto direction = joint_action.get_action(agent).direction;
+		joint_action.update_action(agent, Direction::NONE);
+		environment.act(current_state, joint_action, Print_Level::NOPE);
+		joint_action.update_action(agent, direction);
+		result.push_back(current_state.contains_item(recipe.result));
+	}
+	return result;
 }
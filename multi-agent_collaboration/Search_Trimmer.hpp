@@ -10,7 +10,11 @@ public:
 	Transforms an agents remaining actions into no-ops as early as possible
 	*/
 	void trim(std::vector<Joint_Action>& actions, const State& state, const Environment& environment, const Recipe& recipe) const;
-	void trim_forward(std::vector<Joint_Action>& actions, const State& state, const Environment& environment, const Recipe& recipe) const;
+	// Returns true if any action was changed
+	bool trim_forward(std::vector<Joint_Action>& actions, const State& state, const Environment& environment, const Recipe& recipe) const;
 private:
+	// Whether the result exists after each action when agent is idle throughout, actions is restored before returning
+	std::vector<bool> get_result_steps(size_t agent, const State& state, const Environment& environment, 
+		const Recipe& recipe, std::vector<Joint_Action>& actions) const;
 	std::vector<Joint_Action> apply_modified_actions(size_t action_index, size_t end_index, size_t agent, State& current_state, const Environment& environment, const std::vector<Joint_Action>& actions) const;
 };
\ No newline at end of file
@@ -306,20 +306,21 @@ bool Sliding_Recogniser::is_probable_normalised(Goal goal, const std::vector<Goa
 
 	auto normalised_prob = it->second.probability / highest_prob;
 
-	std::stringstream buffer;
-	buffer << std::setprecision(3);
-	buffer << "Norm Prob: " 
-		<< goal.recipe.result_char() 
-		<< goal.agents.to_string() 
-		<< "/"
-		<< goal.handoff_agent.to_string()
-		<< ":" 
-		<< acting_agent.id 
-		<< " = " 
-		<< normalised_prob 
-		<< "\n";
-
-	PRINT(Print_Category::RECOGNISER, Print_Level::DEBUG, buffer.str());
+	if (is_print_allowed(Print_Category::RECOGNISER, Print_Level::DEBUG)) {
+		std::stringstream buffer;
+		buffer << std::setprecision(3);
+		buffer << "Norm Prob: " 
+			<< goal.recipe.result_char() 
+			<< goal.agents.to_string() 
+			<< "/"
+			<< goal.handoff_agent.to_string()
+			<< ":" 
+			<< acting_agent.id 
+			<< " = " 
+			<< normalised_prob 
+			<< "\n";
+		PRINT(Print_Category::RECOGNISER, Print_Level::DEBUG, buffer.str());
+	}
 
 	return normalised_prob >= charlie;
 }
@@ -334,6 +335,9 @@ float Sliding_Recogniser::get_probability(const Goal& goal) const {
 }
 
 void Sliding_Recogniser::print_probabilities() const {
+	if (!is_print_allowed(Print_Category::RECOGNISER, Print_Level::DEBUG)) {
+		return;
+	}
 	for (const auto& [key, val] : goals) {
 		if (!val.is_current(time_step)) continue;
 		PRINT(Print_Category::RECOGNISER, Print_Level::DEBUG, 
@@ -1,47 +1,140 @@
 #include "State.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+State::State() : items(), goal_items(), agents(), layout(nullptr), width(0), height(0), goal_item_count(0), 
+	agent_count(0), hash(0) {}
+
+State::State(const Environment& environment) : State() {
+	auto width = environment.get_width();
+	auto height = environment.get_height();
+	if (width * height > STATE_MAX_CELLS || width > UINT8_MAX || height > UINT8_MAX) {
+		throw std::runtime_error("Level of size " + std::to_string(width) + "x" + std::to_string(height) 
+			+ " exceeds STATE_MAX_CELLS " + std::to_string(STATE_MAX_CELLS));
+	}
+	this->width = static_cast<uint8_t>(width);
+	this->height = static_cast<uint8_t>(height);
+	layout = get_layout(environment);
+}
+
+// Slots only depend on the dimensions and the walls
+const State::Layout* State::get_layout(const Environment& environment) {
+	static std::mutex mutex;
+	static std::map<std::string, std::unique_ptr<const Layout>> layouts;
+
+	std::string walls;
+	for (size_t x = 0; x < environment.get_width(); ++x) {
+		for (size_t y = 0; y < environment.get_height(); ++y) {
+			walls += environment.is_cell_type({ x, y }, Cell_Type::WALL) ? '1' : '0';
+		}
+	}
+	if (std::count(walls.begin(), walls.end(), '1') > STATE_MAX_COUNTERS) {
+		throw std::runtime_error("Number of counters exceeds STATE_MAX_COUNTERS " + std::to_string(STATE_MAX_COUNTERS));
+	}
+
+	std::string key = std::to_string(environment.get_width()) + "x" + std::to_string(environment.get_height()) + ":" + walls;
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& layout = layouts[key];
+	if (!layout) {
+		auto new_layout = std::make_unique<Layout>();
+		for (size_t cell = 0; cell < walls.size(); ++cell) {
+			if (walls[cell] == '1') {
+				new_layout->cell_slots.push_back(static_cast<Slot>(new_layout->slot_cells.size()));
+				new_layout->slot_cells.push_back(static_cast<Cell>(cell));
+			} else {
+				new_layout->cell_slots.push_back(NO_SLOT);
+			}
+		}
+		layout = std::move(new_layout);
+	}
+	return layout.get();
+}
+
 bool State::operator<(const State& other) const {
+	flush_print();
 	std::cout << "<state" << std::endl;
-	if (this->items.size() != other.items.size()) return this->items.size() < other.items.size();
-	if (this->goal_items.size() != other.goal_items.size()) return this->goal_items.size() < other.goal_items.size();
-	if (this->agents.size() != other.agents.size()) return this->agents.size() < other.agents.size();
-
-	if (this->items < other.items) return true;
-	if (this->items > other.items) return false;
-	if (this->goal_items < other.goal_items) return true;
-	if (this->goal_items > other.goal_items) return false;
-	if (this->agents < other.agents) return true;
-	//if (this->agents > other.agents) return false;
-	return false;
+	if (this->agent_count != other.agent_count) return this->agent_count < other.agent_count;
+	if (this->goal_item_count != other.goal_item_count) return this->goal_item_count < other.goal_item_count;
+	if (this->items != other.items) return this->items < other.items;
+	if (this->goal_items != other.goal_items) return this->goal_items < other.goal_items;
+	return this->agents < other.agents;
+}
+
+State::Cell State::to_cell(const Coordinate& coordinate) const {
+	if (coordinate.first >= width || coordinate.second >= height) {
+		return NO_CELL;
+	}
+	return static_cast<Cell>(coordinate.first * height + coordinate.second);
+}
+
+State::Slot State::to_slot(const Coordinate& coordinate) const {
+	auto cell = to_cell(coordinate);
+	return cell == NO_CELL ? NO_SLOT : layout->cell_slots[cell];
+}
+
+Coordinate State::to_coordinate(Cell cell) const {
+	if (cell == NO_CELL) {
+		return { EMPTY_VAL, EMPTY_VAL };
+	}
+	return { cell / height, cell % height };
+}
+
+Coordinate State::slot_coordinate(size_t slot) const {
+	return to_coordinate(layout->slot_cells[slot]);
+}
+
+size_t State::slot_count() const {
+	return layout == nullptr ? 0 : layout->slot_cells.size();
 }
 
 std::optional<Agent_Id> State::get_agent(Coordinate coordinate) const {
-	size_t agent_index = 0;
-	for (const auto& agent : agents) {
-		if (agent.coordinate == coordinate) {
+	auto cell = to_cell(coordinate);
+	if (cell == NO_CELL) {
+		return {};
+	}
+	for (size_t agent_index = 0; agent_index < agent_count; ++agent_index) {
+		if (get_cell(agents[agent_index]) == cell) {
 			return { agent_index };
 		}
-		++agent_index;
 	}
 	return {};
 }
 
 Agent State::get_agent(Agent_Id agent) const {
-	assert(agent.id < agents.size());
-	return agents.at(agent.id);
+	assert(agent.id < agent_count);
+	auto item = get_agent_item(agent);
+	if (item.has_value()) {
+		return { get_location(agent), item.value() };
+	} else {
+		return { get_location(agent) };
+	}
+}
+
+std::optional<Ingredient> State::get_agent_item(Agent_Id agent) const {
+	assert(agent.id < agent_count);
+	auto item = get_ingredient(agents[agent.id]);
+	if (item == NO_INGREDIENT) {
+		return {};
+	}
+	return static_cast<Ingredient>(item);
 }
 
 size_t State::get_count(Ingredient ingredient) const {
+	auto item = static_cast<uint8_t>(ingredient);
 	size_t count = 0;
-	for (const auto& [coord, ingredient_entry] : items) {
-		if (ingredient == ingredient_entry) {
+	for (size_t slot = 0; slot < slot_count(); ++slot) {
+		if (items[slot] == item) {
 			++count;
 		}
 	}
 
-	for (size_t i = 0; i < agents.size(); ++i) {
-		auto& agent_item = agents.at(i).item;
-		if (agent_item.has_value() && agent_item.value() == ingredient) {
+	for (size_t i = 0; i < agent_count; ++i) {
+		if (get_ingredient(agents[i]) == item) {
 			++count;
 		}
 	}
@@ -49,111 +142,180 @@ size_t State::get_count(Ingredient ingredient) const {
 }
 
 std::optional<Ingredient> State::get_ingredient_at_position(Coordinate coordinate) const {
-	auto it = items.find(coordinate);
-	if (it != items.end()) {
-		return it->second;
-	} else {
+	auto slot = to_slot(coordinate);
+	if (slot == NO_SLOT || items[slot] == NO_INGREDIENT) {
 		return {};
 	}
+	return static_cast<Ingredient>(items[slot]);
 }
 
 Ingredients State::get_ingredients_count() const {
 	Ingredients ingredients;
-	for (const auto& [coord, ingredient] : items) {
-		ingredients.add_ingredient(ingredient);
+	for (size_t slot = 0; slot < slot_count(); ++slot) {
+		if (items[slot] != NO_INGREDIENT) {
+			ingredients.add_ingredient(static_cast<Ingredient>(items[slot]));
+		}
 	}
-	for (const auto& [coord, ingredient] : goal_items) {
-		ingredients.add_ingredient(ingredient);
+	for (size_t i = 0; i < goal_item_count; ++i) {
+		for (size_t count = goal_items[i] >> 8; count > 0; --count) {
+			ingredients.add_ingredient(static_cast<Ingredient>(get_ingredient(goal_items[i])));
+		}
 	}
-	for (const auto& agent : agents) {
-		if (agent.item.has_value()) {
-			ingredients.add_ingredient(agent.item.value());
+	for (size_t i = 0; i < agent_count; ++i) {
+		if (get_ingredient(agents[i]) != NO_INGREDIENT) {
+			ingredients.add_ingredient(static_cast<Ingredient>(get_ingredient(agents[i])));
 		}
 	}
 	return ingredients;
 }
 
 bool State::is_wall_occupied(const Coordinate& coord) const {
-	return items.find(coord) != items.end();
+	auto slot = to_slot(coord);
+	return slot != NO_SLOT && items[slot] != NO_INGREDIENT;
 }
 
 Coordinate State::get_location(Agent_Id agent) const {
-	return agents.at(agent.id).coordinate;
+	assert(agent.id < agent_count);
+	return to_coordinate(get_cell(agents[agent.id]));
+}
+
+size_t State::get_number_of_agents() const {
+	return agent_count;
 }
 
 bool State::contains_item(Ingredient ingredient) const {
-	for (const auto& item : items) {
-		if (item.second == ingredient) return true;
+	auto item = static_cast<uint8_t>(ingredient);
+	for (size_t slot = 0; slot < slot_count(); ++slot) {
+		if (items[slot] == item) return true;
 	}
-	for (const auto& item : goal_items) {
-		if (item.second == ingredient) return true;
+	for (size_t i = 0; i < goal_item_count; ++i) {
+		if (get_ingredient(goal_items[i]) == item) return true;
 	}
-	for (const auto& agent : agents) {
-		if (agent.item == ingredient) return true;
+	for (size_t i = 0; i < agent_count; ++i) {
+		if (get_ingredient(agents[i]) == item) return true;
 	}
 	return false;
 }
 
 void State::add(Coordinate coordinate, Ingredient ingredient) {
-	items.insert({ coordinate, ingredient });
+	auto slot = to_slot(coordinate);
+	if (slot == NO_SLOT) {
+		throw std::runtime_error("Items can only be placed on walls");
+	}
+	if (items[slot] == NO_INGREDIENT) {
+		items[slot] = static_cast<uint8_t>(ingredient);
+		hash ^= item_key(layout->slot_cells[slot], items[slot]);
+	}
 }
 
-void State::add_goal_item(Coordinate coordinate, Ingredient ingredient) {
-	goal_items.push_back({ coordinate, ingredient });
+void State::add_agent(Coordinate coordinate) {
+	if (agent_count == STATE_MAX_AGENTS) {
+		throw std::runtime_error("Number of agents exceeds STATE_MAX_AGENTS " + std::to_string(STATE_MAX_AGENTS));
+	}
+	agents[agent_count] = pack(to_cell(coordinate), NO_INGREDIENT);
+	hash ^= agent_key(agent_count, agents[agent_count]);
+	++agent_count;
+}
+
+// Only the delivered ingredient is kept, not where it was delivered
+void State::add_goal_item(Coordinate /*coordinate*/, Ingredient ingredient) {
+	auto item = static_cast<uint8_t>(ingredient);
+	for (size_t i = 0; i < goal_item_count; ++i) {
+		if (get_ingredient(goal_items[i]) == item) {
+			goal_items[i] += 1 << 8;
+			return;
+		}
+	}
+	if (goal_item_count == STATE_MAX_GOAL_KINDS) {
+		throw std::runtime_error("Kinds of delivered items exceed STATE_MAX_GOAL_KINDS " + std::to_string(STATE_MAX_GOAL_KINDS));
+	}
+	goal_items[goal_item_count] = 1 << 8 | item;
+	++goal_item_count;
 }
 
 void State::remove(Coordinate coordinate) {
-	items.erase(items.find(coordinate));
+	auto slot = to_slot(coordinate);
+	assert(slot != NO_SLOT && items[slot] != NO_INGREDIENT);
+	hash ^= item_key(layout->slot_cells[slot], items[slot]);
+	items[slot] = NO_INGREDIENT;
+}
+
+void State::move_agent(Agent_Id agent, Coordinate coordinate) {
+	assert(agent.id < agent_count);
+	auto& entry = agents[agent.id];
+	auto new_entry = pack(to_cell(coordinate), get_ingredient(entry));
+	hash ^= agent_key(agent.id, entry) ^ agent_key(agent.id, new_entry);
+	entry = new_entry;
+}
+
+void State::set_agent_item(Agent_Id agent, Ingredient ingredient) {
+	assert(agent.id < agent_count);
+	auto& entry = agents[agent.id];
+	auto new_entry = pack(get_cell(entry), static_cast<uint8_t>(ingredient));
+	hash ^= agent_key(agent.id, entry) ^ agent_key(agent.id, new_entry);
+	entry = new_entry;
+}
+
+void State::clear_agent_item(Agent_Id agent) {
+	assert(agent.id < agent_count);
+	auto& entry = agents[agent.id];
+	auto new_entry = pack(get_cell(entry), NO_INGREDIENT);
+	hash ^= agent_key(agent.id, entry) ^ agent_key(agent.id, new_entry);
+	entry = new_entry;
 }
 
 std::string State::to_hash_string() const {
-	std::string hash;
-	hash += std::to_string(items.size() * 128 + agents.size());
-	for (const auto& item : items) {
-		hash += std::to_string(item.first.first * 128 + item.first.second)
-			+ static_cast<char>(item.second);
+	std::string result;
+	size_t item_count = 0;
+	for (size_t slot = 0; slot < slot_count(); ++slot) {
+		if (items[slot] != NO_INGREDIENT) ++item_count;
+	}
+	result += std::to_string(item_count * 128 + agent_count);
+	for (size_t slot = 0; slot < slot_count(); ++slot) {
+		if (items[slot] != NO_INGREDIENT) {
+			auto coordinate = slot_coordinate(slot);
+			result += std::to_string(coordinate.first * 128 + coordinate.second)
+				+ static_cast<char>(items[slot]);
+		}
 	}
 
-	for (const auto& agent : agents) {
-		hash += std::to_string(agent.coordinate.first * 128 + agent.coordinate.second);
-		if (agent.item.has_value()) {
-			hash += static_cast<char>(agent.item.value());
+	for (size_t i = 0; i < agent_count; ++i) {
+		auto coordinate = to_coordinate(get_cell(agents[i]));
+		result += std::to_string(coordinate.first * 128 + coordinate.second);
+		if (get_ingredient(agents[i]) != NO_INGREDIENT) {
+			result += static_cast<char>(get_ingredient(agents[i]));
 		}
-		hash += "0";
+		result += "0";
 	}
-	return hash;
+	return result;
 }
 
-size_t State::to_hash() const {
-	return std::hash<std::string>()(this->to_hash_string());
+uint64_t State::to_hash() const {
+	return hash;
 }
 
+// Delivered items are not part of equality, same as for the hash
 bool State::operator==(const State& other) const {
-	if (items.size() != other.items.size()) return false;
-	if (agents.size() != other.agents.size()) return false;
-	for (size_t i = 0; i < agents.size(); ++i) {
-		if (agents.at(i) != other.agents.at(i)) return false;
-	}
-	for (const auto& item : items) {
-		auto it = other.items.find(item.first);
-		if (it == other.items.end()) return false;
-		if (item.second != it->second) return false;
-	}
-	return true;
+	return hash == other.hash
+		&& agent_count == other.agent_count
+		&& std::memcmp(agents.data(), other.agents.data(), agent_count * sizeof(Packed_Entry)) == 0
+		&& slot_count() == other.slot_count()
+		&& std::memcmp(items.data(), other.items.data(), slot_count()) == 0;
 }
 
 
 std::vector<Coordinate> State::get_coordinates(Ingredient ingredient, bool include_agent_holding) const {
+	auto item = static_cast<uint8_t>(ingredient);
 	std::vector<Coordinate> result;
-	for (const auto& item : items) {
-		if (item.second == ingredient) {
-			result.push_back(item.first);
+	for (size_t slot = 0; slot < slot_count(); ++slot) {
+		if (items[slot] == item) {
+			result.push_back(slot_coordinate(slot));
 		}
 	}
 	if (include_agent_holding) {
-		for (const auto& agent : agents) {
-			if (agent.item == ingredient) {
-				result.push_back(agent.coordinate);
+		for (size_t i = 0; i < agent_count; ++i) {
+			if (get_ingredient(agents[i]) == item) {
+				result.push_back(to_coordinate(get_cell(agents[i])));
 			}
 		}
 	}
@@ -161,67 +323,99 @@ std::vector<Coordinate> State::get_coordinates(Ingredient ingredient, bool inclu
 }
 
 std::vector<Location> State::get_locations(Ingredient ingredient) const {
+	auto item = static_cast<uint8_t>(ingredient);
 	std::vector<Location> result;
-	for (const auto& item : items) {
-		if (item.second == ingredient) {
-			result.push_back({ item.first, item.first, false });
+	for (size_t slot = 0; slot < slot_count(); ++slot) {
+		if (items[slot] == item) {
+			auto coordinate = slot_coordinate(slot);
+			result.push_back({ coordinate, coordinate, false });
 		}
 	}
-	for (const auto& agent : agents) {
-		if (agent.item == ingredient) {
-			result.push_back({ agent.coordinate, agent.coordinate, false });
+	for (size_t i = 0; i < agent_count; ++i) {
+		if (get_ingredient(agents[i]) == item) {
+			auto coordinate = to_coordinate(get_cell(agents[i]));
+			result.push_back({ coordinate, coordinate, false });
 		}
 	}
 	return result;
 }
 
 std::vector<Location> State::get_non_wall_locations(Ingredient ingredient, const Environment& environment) const {
+	auto item = static_cast<uint8_t>(ingredient);
 	std::vector<Location> result;
-	for (const auto& item : items) {
-		if (item.second == ingredient) {
-			if (environment.is_cell_type(item.first, Cell_Type::WALL)) {
-				for (const auto& coord : environment.get_neighbours(item.first)) {
-					if (environment.is_inbound(coord) && !environment.is_cell_type(coord, Cell_Type::WALL)) {
-						result.push_back({ coord, item.first, true });
-					}
+	auto add_location = [&](const Coordinate& coordinate) {
+		if (environment.is_cell_type(coordinate, Cell_Type::WALL)) {
+			for (const auto& coord : environment.get_neighbours(coordinate)) {
+				if (environment.is_inbound(coord) && !environment.is_cell_type(coord, Cell_Type::WALL)) {
+					result.push_back({ coord, coordinate, true });
 				}
-			} else {
-				result.push_back({ item.first, item.first, false });
 			}
+		} else {
+			result.push_back({ coordinate, coordinate, false });
 		}
-	}
-	for (const auto& agent : agents) {
-		if (agent.item == ingredient) {
-			if (environment.is_cell_type(agent.coordinate, Cell_Type::WALL)) {
-				for (const auto& coord : environment.get_neighbours(agent.coordinate)) {
-					if (environment.is_inbound(coord) && !environment.is_cell_type(coord, Cell_Type::WALL)) {
-						result.push_back({ coord, agent.coordinate, true });
-					}
-				}
-			} else {
-				result.push_back({ agent.coordinate, agent.coordinate, false });
-			}
+	};
 
+	for (size_t slot = 0; slot < slot_count(); ++slot) {
+		if (items[slot] == item) {
+			add_location(slot_coordinate(slot));
+		}
+	}
+	for (size_t i = 0; i < agent_count; ++i) {
+		if (get_ingredient(agents[i]) == item) {
+			add_location(to_coordinate(get_cell(agents[i])));
 		}
 	}
 	return result;
 }
 
 void State::purge(const Agent_Combination& agents_keep) {
-	for (size_t i = 0; i < agents.size(); ++i) {
+	for (size_t i = 0; i < agent_count; ++i) {
 		if (!agents_keep.contains({ i })) {
-			agents.at(i).coordinate = { EMPTY_VAL, EMPTY_VAL };
+			auto new_entry = pack(NO_CELL, get_ingredient(agents[i]));
+			hash ^= agent_key(i, agents[i]) ^ agent_key(i, new_entry);
+			agents[i] = new_entry;
 		}
 	}
 }
 
+// Keeps ingredient1, ingredient2 and all agent positions. Other items are replaced by other,
+// delivered items are dropped.
+State State::get_projection(Ingredient ingredient1, Ingredient ingredient2, Ingredient other) const {
+
+	auto keep1 = static_cast<uint8_t>(ingredient1);
+	auto keep2 = static_cast<uint8_t>(ingredient2);
+	auto other_item = static_cast<uint8_t>(other);
+	auto is_kept = [&](uint8_t item) {
+		return item == NO_INGREDIENT || item == keep1 || item == keep2;
+	};
+
+	State result = *this;
+	result.goal_item_count = 0;
+	for (size_t slot = 0; slot < slot_count(); ++slot) {
+		auto item = items[slot];
+		if (is_kept(item)) continue;
+		auto cell = layout->slot_cells[slot];
+		result.hash ^= item_key(cell, item) ^ item_key(cell, other_item);
+		result.items[slot] = other_item;
+	}
+	for (size_t i = 0; i < agent_count; ++i) {
+		if (is_kept(get_ingredient(agents[i]))) continue;
+		auto new_entry = pack(get_cell(agents[i]), other_item);
+		result.hash ^= agent_key(i, agents[i]) ^ agent_key(i, new_entry);
+		result.agents[i] = new_entry;
+	}
+	return result;
+}
+
 void State::print_compact() const {
-	for (const auto& item : items) {
-		std::cout << "(" << static_cast<char>(item.second) << ", " << item.first.first << ", " << item.first.second << ") ";
+	flush_print();
+	for (size_t slot = 0; slot < slot_count(); ++slot) {
+		if (items[slot] != NO_INGREDIENT) {
+			auto coordinate = slot_coordinate(slot);
+			std::cout << "(" << static_cast<char>(items[slot]) << ", " << coordinate.first << ", " << coordinate.second << ") ";
+		}
 	}
-	size_t agent_counter = 0;
-	for (const auto& agent : agents) {
-		agent.print_compact({ agent_counter });
-		++agent_counter;
+	for (size_t agent = 0; agent < agent_count; ++agent) {
+		get_agent(agent).print_compact({ agent });
 	}
 }
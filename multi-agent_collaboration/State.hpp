@@ -2,18 +2,69 @@
 #include <optional>
 #include <string>
 #include <vector>
-#include <map>
+#include <array>
+#include <cstdint>
 
 #include "Environment.hpp"
 
+// Fixed capacity of the packed state, override at compile time for larger kitchens.
+// The defaults fit a 16x16 kitchen with up to 96 counters.
+#ifndef STATE_MAX_CELLS
+#define STATE_MAX_CELLS 256
+#endif
 
+#ifndef STATE_MAX_COUNTERS
+#define STATE_MAX_COUNTERS 96
+#endif
+
+#ifndef STATE_MAX_AGENTS
+#define STATE_MAX_AGENTS 10
+#endif
+
+// Distinct delivered ingredients, any number of each can be delivered
+#ifndef STATE_MAX_GOAL_KINDS
+#define STATE_MAX_GOAL_KINDS 8
+#endif
+
+static_assert(STATE_MAX_CELLS < 0xFFFF, "Cell indices must fit in 16 bits, 0xFFFF is reserved for no cell");
+static_assert(STATE_MAX_COUNTERS < 0xFF, "Counter slots must fit in 8 bits, 0xFF is reserved for no slot");
+static_assert(STATE_MAX_AGENTS <= Packed_Joint_Action::MAX_AGENTS, "Joint actions must cover every agent of a state");
+
+// Grid cells are indexed x * height + y. Items only ever lie on walls, so they
+// are stored per counter slot, the level's wall cells in cell order. Iterating
+// the slots visits items in the same order as the std::map<Coordinate, Ingredient>
+// State once used. The slot layout is shared by all states of a level.
+// Agents are packed as (cell << 8 | ingredient), where ingredient 0 means
+// nothing held, delivered items as (count << 8 | ingredient) per ingredient.
+// Capacity errors throw std::runtime_error. A state is trivially copyable.
+// The hash is a Zobrist hash over items and agents, kept up to date by
+// every mutator so hashing a state never walks it.
 struct State {
-		bool operator<(const State& other) const;
+	using Cell = uint16_t;
+	using Slot = uint8_t;
+	using Packed_Entry = uint32_t;
+	static constexpr Cell NO_CELL = 0xFFFF;
+	static constexpr Slot NO_SLOT = 0xFF;
+	static constexpr uint8_t NO_INGREDIENT = 0;
+
+	// Counter slots of one level layout, kept for the life of the process
+	struct Layout {
+		std::vector<Slot> cell_slots;	// Slot of every cell, NO_SLOT for floor
+		std::vector<Cell> slot_cells;	// Cell of every slot, ascending
+	};
+
+	State();
+	explicit State(const Environment& environment);
+
+	bool operator<(const State& other) const;
 	void						add(Coordinate coordinate, Ingredient ingredient);
+	void						add_agent(Coordinate coordinate);
 	void						add_goal_item(Coordinate coordinate, Ingredient ingredient);
+	void						clear_agent_item(Agent_Id agent);
 	bool						contains_item(Ingredient ingredient) const;
 	std::optional<Agent_Id>		get_agent(Coordinate coordinate) const;
 	Agent						get_agent(Agent_Id agent) const;
+	std::optional<Ingredient>	get_agent_item(Agent_Id agent) const;
 	std::vector<Coordinate>		get_coordinates(Ingredient ingredient, bool include_agent_holding) const;
 	size_t						get_count(Ingredient ingredient) const;
 	std::optional<Ingredient>	get_ingredient_at_position(Coordinate coordinate) const;
@@ -21,18 +72,63 @@ struct State {
 	Coordinate					get_location(Agent_Id agent) const;
 	std::vector<Location>		get_locations(Ingredient ingredient) const;
 	std::vector<Location>		get_non_wall_locations(Ingredient ingredient, const Environment& environment) const;
+	size_t						get_number_of_agents() const;
+	State						get_projection(Ingredient ingredient1, Ingredient ingredient2, Ingredient other) const;
 	bool						is_wall_occupied(const Coordinate& coord) const;
 	bool						items_hoarded(const Recipe& recipe, const Agent_Combination& available_agents) const;
+	void						move_agent(Agent_Id agent, Coordinate coordinate);
 	void						print_compact() const;
 	void						purge(const Agent_Combination& agents);
 	void						remove(Coordinate coordinate);
+	void						set_agent_item(Agent_Id agent, Ingredient ingredient);
 	std::string					to_hash_string() const;
-	size_t						to_hash() const;
+	uint64_t					to_hash() const;
 	bool operator==(const State& other) const;
 
-	std::map<Coordinate, Ingredient> items;
-	std::vector<std::pair<Coordinate, Ingredient>> goal_items;
-	std::vector<Agent> agents;
+	std::array<uint8_t, STATE_MAX_COUNTERS>			items;
+	std::array<Packed_Entry, STATE_MAX_GOAL_KINDS>	goal_items;
+	std::array<Packed_Entry, STATE_MAX_AGENTS>		agents;
+	const Layout* layout;
+	uint8_t width;
+	uint8_t height;
+	uint8_t goal_item_count;
+	uint8_t agent_count;
+	uint64_t hash;
+
+	// Zobrist key for an arbitrary feature tag, derived with splitmix64 so no table is needed
+	static constexpr uint64_t zobrist_key(uint64_t tag) {
+		uint64_t z = tag + 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+private:
+	static const Layout* get_layout(const Environment& environment);
+
+	Cell		to_cell(const Coordinate& coordinate) const;
+	Slot		to_slot(const Coordinate& coordinate) const;
+	Coordinate	to_coordinate(Cell cell) const;
+	Coordinate	slot_coordinate(size_t slot) const;
+	size_t		slot_count() const;
+
+	static Packed_Entry pack(Cell cell, uint8_t ingredient) {
+		return static_cast<Packed_Entry>(cell) << 8 | ingredient;
+	}
+	static Cell get_cell(Packed_Entry entry) {
+		return static_cast<Cell>(entry >> 8);
+	}
+	static uint8_t get_ingredient(Packed_Entry entry) {
+		return static_cast<uint8_t>(entry & 0xFF);
+	}
+
+	// Empty cells and empty hands contribute nothing to the hash
+	static uint64_t item_key(Cell cell, uint8_t ingredient) {
+		return ingredient == NO_INGREDIENT ? 0 : zobrist_key((1ull << 32) | (static_cast<uint64_t>(cell) << 8) | ingredient);
+	}
+	static uint64_t agent_key(size_t agent, Packed_Entry entry) {
+		return zobrist_key((2ull << 32) | (static_cast<uint64_t>(agent) << 40) | entry);
+	}
 };
 
 namespace std {
@@ -45,4 +141,4 @@ namespace std {
 			return obj.to_hash();
 		}
 	};
-}
\ No newline at end of file
+}
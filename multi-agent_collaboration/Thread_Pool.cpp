@@ -0,0 +1,104 @@
+#include "Thread_Pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+Thread_Pool::Thread_Pool(size_t thread_count)
+	: threads(), current_task(nullptr), task_count(0), next_task(0), busy_workers(0),
+	generation(0), stopping(false), error() {
+
+	for (size_t worker_index = 1; worker_index < thread_count; ++worker_index) {
+		threads.emplace_back(&Thread_Pool::worker_loop, this, worker_index);
+	}
+}
+
+Thread_Pool::~Thread_Pool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	work_available.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+size_t Thread_Pool::default_thread_count() {
+#ifdef PLANNER_THREADS
+	return PLANNER_THREADS;
+#else
+	return std::max<size_t>(1, std::thread::hardware_concurrency());
+#endif
+}
+
+size_t Thread_Pool::size() const {
+	return threads.size() + 1;
+}
+
+void Thread_Pool::run(size_t task_count_in, const std::function<void(size_t, size_t)>& task) {
+	if (threads.empty() || task_count_in <= 1) {
+		for (size_t task_index = 0; task_index < task_count_in; ++task_index) {
+			task(task_index, 0);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		current_task = &task;
+		task_count = task_count_in;
+		next_task = 0;
+		busy_workers = threads.size();
+		++generation;
+	}
+	work_available.notify_all();
+
+	work(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	work_done.wait(lock, [this] { return busy_workers == 0; });
+	current_task = nullptr;
+	if (error) {
+		std::rethrow_exception(std::exchange(error, nullptr));
+	}
+}
+
+void Thread_Pool::work(size_t worker_index) {
+	while (true) {
+		size_t task_index = next_task.fetch_add(1);
+		if (task_index >= task_count) {
+			return;
+		}
+		try {
+			(*current_task)(task_index, worker_index);
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+			next_task = task_count;
+		}
+	}
+}
+
+void Thread_Pool::worker_loop(size_t worker_index) {
+	size_t seen_generation = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			work_available.wait(lock, [&] { return stopping || generation != seen_generation; });
+			if (stopping) {
+				return;
+			}
+			seen_generation = generation;
+		}
+
+		work(worker_index);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--busy_workers;
+		}
+		work_done.notify_one();
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+Fixed set of worker threads running blocking parallel loops. The calling thread
+takes part as worker 0, so a pool of size 1 runs everything inline.
+*/
+class Thread_Pool {
+public:
+	explicit Thread_Pool(size_t thread_count);
+	~Thread_Pool();
+	Thread_Pool(const Thread_Pool&) = delete;
+	Thread_Pool& operator=(const Thread_Pool&) = delete;
+
+	// Calls task(task_index, worker_index) for every task_index < task_count and
+	// returns once all of them have finished. If a task throws, tasks not yet started
+	// are skipped and the first exception is rethrown once every worker is done.
+	void	run(size_t task_count, const std::function<void(size_t, size_t)>& task);
+	size_t	size() const;
+
+	// Worker count used when none is given, PLANNER_THREADS overrides hardware concurrency
+	static size_t default_thread_count();
+
+private:
+	void	work(size_t worker_index);
+	void	worker_loop(size_t worker_index);
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable work_available;
+	std::condition_variable work_done;
+	const std::function<void(size_t, size_t)>* current_task;
+	size_t task_count;
+	std::atomic<size_t> next_task;
+	size_t busy_workers;
+	size_t generation;
+	bool stopping;
+	std::exception_ptr error;	// First exception thrown by a task of the current run
+};
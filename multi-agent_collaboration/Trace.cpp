@@ -0,0 +1,90 @@
+#include "Trace.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace {
+	struct Trace_Event {
+		const char* name;
+		std::string label;
+		int64_t start_ns;
+		int64_t end_ns;
+		uint32_t thread;
+	};
+
+	std::mutex trace_mutex;
+	std::vector<Trace_Event> trace_events;
+	std::atomic<uint32_t> next_trace_thread(0);
+	const auto trace_epoch = std::chrono::steady_clock::now();
+
+	// Small stable ids read better in the viewer than hashed std::thread::id
+	uint32_t get_trace_thread() {
+		thread_local uint32_t thread = next_trace_thread.fetch_add(1);
+		return thread;
+	}
+
+	void write_json_string(std::ostream& out, const std::string& text) {
+		out << '"';
+		for (auto c : text) {
+			if (c == '"' || c == '\\') {
+				out << '\\' << c;
+			} else if (c == '\n') {
+				out << "\\n";
+			} else {
+				out << c;
+			}
+		}
+		out << '"';
+	}
+}
+
+std::atomic<bool> trace_recording(false);
+
+void start_trace() {
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	trace_events.clear();
+	trace_recording.store(true);
+}
+
+int64_t get_trace_time_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - trace_epoch).count();
+}
+
+void record_trace_event(const char* name, std::string label, int64_t start_ns, int64_t end_ns) {
+	auto thread = get_trace_thread();
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	trace_events.push_back({ name, std::move(label), start_ns, end_ns, thread });
+}
+
+void write_trace(const std::string& file_name) {
+	trace_recording.store(false);
+	std::lock_guard<std::mutex> lock(trace_mutex);
+
+	std::ofstream file(file_name);
+	if (!file) {
+		std::cerr << "Could not write trace " << file_name << std::endl;
+		return;
+	}
+	file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+	for (size_t i = 0; i < trace_events.size(); ++i) {
+		const auto& event = trace_events.at(i);
+		file << "{\"name\":";
+		write_json_string(file, event.name);
+		file << ",\"cat\":\"planner\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+			<< ",\"ts\":" << event.start_ns / 1000.0
+			<< ",\"dur\":" << (event.end_ns - event.start_ns) / 1000.0;
+		if (!event.label.empty()) {
+			file << ",\"args\":{\"label\":";
+			write_json_string(file, event.label);
+			file << '}';
+		}
+		file << (i + 1 == trace_events.size() ? "}\n" : "},\n");
+	}
+	file << "],\"displayTimeUnit\":\"ms\"}\n";
+	trace_events.clear();
+}
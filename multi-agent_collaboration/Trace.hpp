@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Set to 0 to compile every trace span out
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+extern std::atomic<bool> trace_recording;
+
+inline bool is_trace_recording() {
+	return trace_recording.load(std::memory_order_relaxed);
+}
+
+// Clears earlier events and starts recording spans
+void start_trace();
+
+// Stops recording and writes the events as Chrome trace-event JSON (chrome://tracing, Perfetto)
+void write_trace(const std::string& file_name);
+
+int64_t get_trace_time_ns();
+void record_trace_event(const char* name, std::string label, int64_t start_ns, int64_t end_ns);
+
+/**
+Records the time from construction to destruction as one complete event.
+Costs a single relaxed load when no trace is being recorded.
+*/
+class Trace_Span {
+public:
+	explicit Trace_Span(const char* name)
+		: name(name), label(), start_ns(is_trace_recording() ? get_trace_time_ns() : -1) {}
+
+	// make_label is only called while recording
+	template<typename Label_Function>
+	Trace_Span(const char* name, Label_Function&& make_label) : Trace_Span(name) {
+		if (start_ns >= 0) {
+			label = make_label();
+		}
+	}
+
+	~Trace_Span() {
+		if (start_ns >= 0) {
+			record_trace_event(name, std::move(label), start_ns, get_trace_time_ns());
+		}
+	}
+
+	Trace_Span(const Trace_Span&) = delete;
+	Trace_Span& operator=(const Trace_Span&) = delete;
+
+private:
+	const char* name;
+	std::string label;
+	int64_t start_ns;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#if TRACE_ENABLED
+#define TRACE_SPAN(name) Trace_Span TRACE_CONCAT(trace_span_, __LINE__)(name)
+#define TRACE_SPAN_LABELLED(name, label) \
+	Trace_Span TRACE_CONCAT(trace_span_, __LINE__)(name, [&]() { return std::string(label); })
+#else
+#define TRACE_SPAN(name) ((void)0)
+#define TRACE_SPAN_LABELLED(name, label) ((void)0)
+#endif
@@ -5,71 +5,53 @@
 #include <vector>
 #include <cassert>
 
-// Get all combinations of numbers/agents <n
+// All non-empty subsets of agents, in increasing order of their mask
 std::vector<Agent_Combination> get_combinations(Agent_Combination agents) {
-	std::vector<size_t> converted;
-	for (auto& entry : agents.agents) {
-		converted.push_back(entry.id);
+	std::vector<Agent_Combination> combinations;
+	auto mask = agents.get_mask();
+	if (mask == 0) return combinations;
+	combinations.reserve((size_t{ 1 } << agents.size()) - 1);
+	for (auto subset = mask & (~mask + 1); subset != 0; subset = (subset - mask) & mask) {
+		combinations.push_back(Agent_Combination::from_mask(subset));
 	}
-	return get_combinations(converted);
+	return combinations;
 }
 
+// Get all combinations of numbers/agents <n
 std::vector<Agent_Combination> get_combinations(size_t n) {
-	std::vector<size_t> vec;
-	for (size_t i = 0; i < n; ++i) {
-		vec.push_back(i);
+	assert(n < AGENT_COMBINATION_MAX_AGENTS);
+	std::vector<Agent_Combination> combinations;
+	uint64_t end = uint64_t{ 1 } << n;
+	combinations.reserve(static_cast<size_t>(end - 1));
+	for (uint64_t subset = 1; subset < end; ++subset) {
+		combinations.push_back(Agent_Combination::from_mask(subset));
 	}
-	return get_combinations(vec);
+	return combinations;
 }
 
-// All combinations of all sizes
+// All combinations of all sizes, bit i of the counter selects agents[i]
 std::vector<Agent_Combination> get_combinations(std::vector<size_t> agents) {
 	if (agents.empty()) return {};
-	std::vector<bool> status;
-	status.push_back(true);
-	for (size_t i = 1; i < agents.size(); ++i) {
-		status.push_back(false);
-	}
+	assert(agents.size() < AGENT_COMBINATION_MAX_AGENTS);
 	std::vector<Agent_Combination> combinations;
-
-	bool done = false;
-	while (!done) {
-		
-		// Record next entry
-		std::vector<Agent_Id> next_combination;
-		for (size_t i = 0; i < agents.size(); ++i) {
-			if (status.at(i)) next_combination.push_back(agents.at(i));
-		}
-
-		// Advance status
-		size_t counter = 0;
-		while (true) {
-			status.at(counter) = !status.at(counter);
-			if (status.at(counter)) {
-				break;
-			} else {
-				++counter;
-				if (counter == status.size()) {
-					done = true;
-					break;
-				}
-			}
+	uint64_t end = uint64_t{ 1 } << agents.size();
+	combinations.reserve(static_cast<size_t>(end - 1));
+	for (uint64_t counter = 1; counter < end; ++counter) {
+		Agent_Combination combination;
+		for (auto remaining = counter; remaining != 0; remaining &= remaining - 1) {
+			combination.add(Agent_Id(agents.at(get_lowest_bit(remaining))));
 		}
-
-		combinations.push_back(Agent_Combination(next_combination));
+		combinations.push_back(combination);
 	}
 	return combinations;
 }
 
-
-
-std::vector<Agent_Combination> get_permutations(Agent_Combination agents) {
-	std::vector<Agent_Combination> permutations;
+std::vector<std::vector<Agent_Id>> get_permutations(Agent_Combination agents) {
+	std::vector<std::vector<Agent_Id>> permutations;
 
 	std::vector<Agent_Id> current = agents.get();
-	std::sort(current.begin(), current.end());
 	do {
-		permutations.push_back(Agent_Combination{ current });
+		permutations.push_back(current);
 	} while (std::next_permutation(current.begin(), current.end()));
 	return permutations;
 }
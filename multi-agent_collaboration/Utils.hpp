@@ -8,7 +8,7 @@
 std::vector<Agent_Combination> get_combinations(size_t n);
 std::vector<Agent_Combination> get_combinations(std::vector<size_t> agents);
 std::vector<Agent_Combination> get_combinations(Agent_Combination agents);
-std::vector<Agent_Combination> get_permutations(Agent_Combination agents);
+std::vector<std::vector<Agent_Id>> get_permutations(Agent_Combination agents);
 Direction get_direction(Coordinate from, Coordinate to);
 
 template <typename T>
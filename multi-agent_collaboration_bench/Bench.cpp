@@ -0,0 +1,661 @@
+
+#include "Environment.hpp"
+#include "Planner.hpp"
+#include "Planner_Mac.hpp"
+#include "Planner_Mac_One.hpp"
+#include "Planner_Still.hpp"
+#include "State.hpp"
+#include "Trace.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/**
+Benchmark harness for the planners. Every (level, seed, repetition) combination
+is played from scratch until the level is done or the action limit is hit, and
+one row of measurements is written as soon as the run ends. A run that throws or
+asserts is recorded as failed. Two result files can be compared to spot regressions.
+
+Run from a project directory so the default level glob resolves, e.g.
+	bench --levels ../levels/BD/open-*.txt --planners mac,mac --seeds 0-4 --format json
+	bench --compare before.csv after.csv --tolerance 0.1
+*/
+
+struct Bench_Options {
+	Bench_Options() : levels("../levels/BD/*.txt"), planner_types({ Planner_Types::MAC }),
+		agents(2), seed_first(0), seed_last(0), repetitions(1), max_actions(100), format("csv"),
+		step_budget(Search_Limits::UNLIMITED), depth_bound_slack(DEFAULT_DEPTH_BOUND_SLACK), output(), trace(), compare_base(), compare_new(), tolerance(0.1) {}
+	std::string levels;
+	std::vector<Planner_Types> planner_types;	// One per agent, the last one fills the remaining agents
+	size_t agents;
+	size_t seed_first;
+	size_t seed_last;
+	size_t repetitions;
+	size_t max_actions;
+	std::string format;
+	size_t step_budget;			// Expansions per MAC planner decision, UNLIMITED for no cap
+	size_t depth_bound_slack;
+	std::string output;			// Standard output if empty
+	std::string trace;			// Chrome trace-event file of all runs, none if empty
+	std::string compare_base;
+	std::string compare_new;
+	double tolerance;			// Relative slowdown accepted by compare
+};
+
+struct Run_Result {
+	Run_Result() : level(), planners(), agents(0), seed(0), repetition(0), solved(false), failed(false), actions(0),
+		decisions(0), total_ms(0), p50_us(0), p95_us(0), max_us(0), search_stats(), peak_memory_kb(0) {}
+	std::string level;
+	std::string planners;
+	size_t agents;
+	size_t seed;
+	size_t repetition;
+	bool solved;
+	bool failed;				// Threw or aborted, only the run's identity is recorded
+	size_t actions;
+	size_t decisions;
+	double total_ms;
+	double p50_us;
+	double p95_us;
+	double max_us;
+	Search_Stats search_stats;	// Summed over all planners
+	size_t peak_memory_kb;
+};
+
+static const std::vector<std::string> COLUMNS{ "level", "planners", "agents", "seed", "repetition",
+	"solved", "failed", "actions", "decisions", "total_ms", "p50_us", "p95_us", "max_us",
+	"searches", "generated", "expansions", "duplicates", "stale_pops", "depth_cutoffs", "dead_ends",
+	"heuristic_calls", "heuristic_cache_hits", "intermediate", "improvements", "budget_stops", "budget_skips", "cache_skips",
+	"infeasible_hits", "peak_frontier", "peak_visited", "peak_memory_kb" };
+
+std::string planner_to_string(Planner_Types type) {
+	switch (type) {
+	case Planner_Types::MAC: return "mac";
+	case Planner_Types::MAC_ONE: return "mac1";
+	case Planner_Types::STILL: return "still";
+	}
+	return "?";
+}
+
+Planner_Types string_to_planner(const std::string& name) {
+	if (name == "mac") return Planner_Types::MAC;
+	if (name == "mac1") return Planner_Types::MAC_ONE;
+	if (name == "still") return Planner_Types::STILL;
+	std::cerr << "Unknown planner '" << name << "', expected mac, mac1 or still" << std::endl;
+	exit(-1);
+}
+
+std::vector<std::string> split(const std::string& text, char delimiter) {
+	std::vector<std::string> parts;
+	std::stringstream stream(text);
+	std::string part;
+	while (std::getline(stream, part, delimiter)) {
+		parts.push_back(part);
+	}
+	return parts;
+}
+
+// Matches * and ? against a whole file name
+bool matches_pattern(const std::string& pattern, const std::string& name) {
+	size_t p = 0, n = 0, star = std::string::npos, star_n = 0;
+	while (n < name.size()) {
+		if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+			++p;
+			++n;
+		} else if (p < pattern.size() && pattern[p] == '*') {
+			star = p++;
+			star_n = n;
+		} else if (star != std::string::npos) {
+			p = star + 1;
+			n = ++star_n;
+		} else {
+			return false;
+		}
+	}
+	while (p < pattern.size() && pattern[p] == '*') {
+		++p;
+	}
+	return p == pattern.size();
+}
+
+// Wildcards are supported in the file name only, a directory means all .txt files in it
+std::vector<std::string> get_level_paths(const std::string& glob) {
+	namespace fs = std::filesystem;
+	fs::path glob_path(glob);
+	fs::path directory = glob_path.parent_path();
+	std::string pattern = glob_path.filename().string();
+	if (fs::is_directory(glob_path)) {
+		directory = glob_path;
+		pattern = "*.txt";
+	} else if (pattern.find_first_of("*?") == std::string::npos) {
+		return { glob };
+	}
+	if (directory.empty()) {
+		directory = ".";
+	}
+	if (!fs::is_directory(directory)) {
+		std::cerr << "Level directory " << directory.string() << " does not exist" << std::endl;
+		exit(-1);
+	}
+
+	std::vector<std::string> paths;
+	for (const auto& entry : fs::directory_iterator(directory)) {
+		if (entry.is_regular_file() && matches_pattern(pattern, entry.path().filename().string())) {
+			paths.push_back(entry.path().generic_string());
+		}
+	}
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+// Process high-water mark in KiB
+size_t get_peak_memory_kb() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return counters.PeakWorkingSetSize / 1024;
+	}
+	return 0;
+#else
+#ifdef __linux__
+	// Unlike ru_maxrss, VmHWM follows reset_peak_memory
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.rfind("VmHWM:", 0) == 0) {
+			return std::stoul(line.substr(6));
+		}
+	}
+#endif
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// Lets the peak memory of each run be measured on its own, only Linux supports this.
+// Heap kept by the allocator from earlier runs still counts towards the new peak.
+void reset_peak_memory() {
+#ifdef __linux__
+	std::ofstream clear_refs("/proc/self/clear_refs");
+	clear_refs << "5";
+#endif
+}
+
+// Nearest rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double fraction) {
+	if (sorted.empty()) {
+		return 0;
+	}
+	auto rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+	return sorted.at(std::max<size_t>(rank, 1) - 1);
+}
+
+Planner_Types get_planner_type(const Bench_Options& options, size_t agent) {
+	return options.planner_types.at(std::min(agent, options.planner_types.size() - 1));
+}
+
+// Identifies a run before it starts, a failed run keeps only this
+Run_Result get_run_identity(const std::string& path, const Bench_Options& options, size_t seed, size_t repetition) {
+	Run_Result result;
+	result.level = path;
+	for (size_t agent = 0; agent < options.agents; ++agent) {
+		result.planners += (agent == 0 ? "" : "-") + planner_to_string(get_planner_type(options, agent));
+	}
+	result.agents = options.agents;
+	result.seed = seed;
+	result.repetition = repetition;
+	return result;
+}
+
+Run_Result run_level(const std::string& path, const Bench_Options& options, size_t seed, size_t repetition) {
+	reset_peak_memory();
+
+	auto environment = Environment(options.agents);
+	auto state = environment.load(path);
+	std::vector<Planner> planners;
+	auto context = std::make_shared<Planning_Context>(environment, state);	// Shared by the MAC planners
+	for (size_t agent = 0; agent < environment.get_number_of_agents(); ++agent) {
+		switch (get_planner_type(options, agent)) {
+		case Planner_Types::MAC: {
+			planners.emplace_back(std::make_unique<Planner_Mac>(environment, agent, state, seed, context, 
+				options.step_budget, options.depth_bound_slack));
+			break;
+		}
+		case Planner_Types::MAC_ONE: {
+			planners.emplace_back(std::make_unique<Planner_Mac_One>(environment, agent, state, seed, context, 
+				options.step_budget, options.depth_bound_slack));
+			break;
+		}
+		case Planner_Types::STILL: {
+			planners.emplace_back(std::make_unique<Planner_Still>(environment, agent, state));
+			break;
+		}
+		}
+	}
+
+	// The planners reset the shared engine to a fixed seed when constructed, seed it per run here
+	set_random_seed(seed);
+
+	std::vector<double> latencies;
+	size_t action_count = 0;
+	auto time_start = std::chrono::steady_clock::now();
+	while (!environment.is_done(state) && action_count < options.max_actions) {
+		std::vector<Action> actions;
+		for (auto& planner : planners) {
+			auto decision_start = std::chrono::steady_clock::now();
+			actions.push_back(planner.get_next_action(state));
+			auto decision_end = std::chrono::steady_clock::now();
+			latencies.push_back(std::chrono::duration<double, std::micro>(decision_end - decision_start).count());
+		}
+		environment.act(state, { actions }, Print_Level::NOPE);
+		++action_count;
+	}
+	auto time_end = std::chrono::steady_clock::now();
+
+	Search_Stats search_stats;
+	for (const auto& planner : planners) {
+		search_stats += planner.get_search_stats();
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	auto result = get_run_identity(path, options, seed, repetition);
+	result.solved = environment.is_done(state);
+	result.actions = action_count;
+	result.decisions = latencies.size();
+	result.total_ms = std::chrono::duration<double, std::milli>(time_end - time_start).count();
+	result.p50_us = percentile(latencies, 0.50);
+	result.p95_us = percentile(latencies, 0.95);
+	result.max_us = latencies.empty() ? 0 : latencies.back();
+	result.search_stats = search_stats;
+	result.peak_memory_kb = get_peak_memory_kb();
+	return result;
+}
+
+std::vector<std::string> to_fields(const Run_Result& result) {
+	auto fixed = [](double value) {
+		std::stringstream buffer;
+		buffer << std::fixed << std::setprecision(1) << value;
+		return buffer.str();
+	};
+	return { result.level, result.planners, std::to_string(result.agents), std::to_string(result.seed),
+		std::to_string(result.repetition), result.solved ? "1" : "0", result.failed ? "1" : "0", std::to_string(result.actions),
+		std::to_string(result.decisions), fixed(result.total_ms), fixed(result.p50_us), fixed(result.p95_us),
+		fixed(result.max_us), std::to_string(result.search_stats.searches), std::to_string(result.search_stats.generated),
+		std::to_string(result.search_stats.expanded), std::to_string(result.search_stats.duplicates_merged),
+		std::to_string(result.search_stats.stale_pops), std::to_string(result.search_stats.depth_cutoffs),
+		std::to_string(result.search_stats.dead_ends), std::to_string(result.search_stats.heuristic_calls),
+		std::to_string(result.search_stats.heuristic_cache_hits), std::to_string(result.search_stats.intermediate),
+		std::to_string(result.search_stats.improvements), std::to_string(result.search_stats.budget_stops),
+		std::to_string(result.search_stats.budget_skips), std::to_string(result.search_stats.cache_skips), 
+		std::to_string(result.search_stats.infeasible_hits), std::to_string(result.search_stats.peak_frontier),
+		std::to_string(result.search_stats.peak_visited), std::to_string(result.peak_memory_kb) };
+}
+
+std::string json_escape(const std::string& text) {
+	std::string escaped;
+	for (auto c : text) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+// CSV has a header line, JSON is an array with one flat object per line. Rows are
+// formatted one at a time so they can be written as their runs complete.
+std::string format_header(const std::string& format) {
+	if (format == "json") {
+		return "[\n";
+	}
+	std::string header;
+	for (size_t column = 0; column < COLUMNS.size(); ++column) {
+		header += (column == 0 ? "" : ",") + COLUMNS.at(column);
+	}
+	return header + '\n';
+}
+
+std::string format_row(const Run_Result& result, const std::string& format, bool first_row) {
+	auto fields = to_fields(result);
+	std::string row;
+	if (format == "json") {
+		row = first_row ? "\t{" : ",\n\t{";
+		for (size_t column = 0; column < COLUMNS.size(); ++column) {
+			bool is_string = column < 2;
+			row += (column == 0 ? "\"" : ", \"") + COLUMNS.at(column) + "\": "
+				+ (is_string ? "\"" + json_escape(fields.at(column)) + "\"" : fields.at(column));
+		}
+		return row + "}";
+	}
+	for (size_t column = 0; column < fields.size(); ++column) {
+		row += (column == 0 ? "" : ",") + fields.at(column);
+	}
+	return row + '\n';
+}
+
+std::string format_footer(const std::string& format, bool no_rows) {
+	if (format == "json") {
+		return no_rows ? "]\n" : "\n]\n";
+	}
+	return "";
+}
+
+// Reads rows written by the bench in either format, keyed on column name
+std::vector<std::map<std::string, std::string>> read_results(const std::string& path) {
+	std::ifstream file(path);
+	if (!file) {
+		std::cerr << "Could not open results " << path << std::endl;
+		exit(-1);
+	}
+	std::vector<std::map<std::string, std::string>> rows;
+	std::string line;
+	std::vector<std::string> header;
+	while (std::getline(file, line)) {
+		auto begin = line.find_first_not_of(" \t\r");
+		if (begin == std::string::npos || line[begin] == '[' || line[begin] == ']') {
+			continue;
+		}
+		std::map<std::string, std::string> row;
+		if (line[begin] == '{') {
+			size_t position = begin + 1;
+			while (true) {
+				auto key_begin = line.find('"', position);
+				if (key_begin == std::string::npos) {
+					break;
+				}
+				auto key_end = line.find('"', key_begin + 1);
+				auto value_begin = line.find_first_not_of(": ", key_end + 1);
+				std::string value;
+				if (line[value_begin] == '"') {
+					position = value_begin + 1;
+					while (line[position] != '"') {
+						if (line[position] == '\\') {
+							++position;
+						}
+						value += line[position++];
+					}
+					++position;
+				} else {
+					position = line.find_first_of(",}", value_begin);
+					value = line.substr(value_begin, position - value_begin);
+				}
+				row[line.substr(key_begin + 1, key_end - key_begin - 1)] = value;
+			}
+		} else if (header.empty()) {
+			header = split(line.substr(begin), ',');
+			continue;
+		} else {
+			auto fields = split(line.substr(begin), ',');
+			for (size_t column = 0; column < header.size() && column < fields.size(); ++column) {
+				row[header.at(column)] = fields.at(column);
+			}
+		}
+		rows.push_back(row);
+	}
+	return rows;
+}
+
+struct Compare_Entry {
+	std::vector<double> base_p50, base_p95, new_p50, new_p95;
+	double base_actions = 0, new_actions = 0, base_expansions = 0, new_expansions = 0;
+	size_t base_runs = 0, new_runs = 0;
+	size_t base_solved = 0, new_solved = 0;
+	size_t base_finished = 0, new_finished = 0;	// Runs which did not fail, the only ones with measurements
+};
+
+double median(std::vector<double> values) {
+	if (values.empty()) {
+		return 0;
+	}
+	std::sort(values.begin(), values.end());
+	return values.at(values.size() / 2);
+}
+
+// Rows are matched on level, planners, agents and seed, repetitions are reduced to their median.
+// A configuration regresses when it solves fewer of its runs, fails more of them, needs more actions
+// or expansions, or its latency grows beyond the tolerance. Failed runs count as unsolved and are not measured.
+int compare_results(const Bench_Options& options) {
+	std::map<std::string, Compare_Entry> entries;
+	auto add_rows = [&entries](const std::string& path, bool is_base) {
+		for (auto& row : read_results(path)) {
+			auto key = row["level"] + " " + row["planners"] + " a" + row["agents"] + " s" + row["seed"];
+			auto& entry = entries[key];
+			++(is_base ? entry.base_runs : entry.new_runs);
+			if (row["solved"] == "1") {
+				++(is_base ? entry.base_solved : entry.new_solved);
+			}
+			if (row["failed"] == "1") {
+				continue;
+			}
+			++(is_base ? entry.base_finished : entry.new_finished);
+			(is_base ? entry.base_p50 : entry.new_p50).push_back(std::stod(row["p50_us"]));
+			(is_base ? entry.base_p95 : entry.new_p95).push_back(std::stod(row["p95_us"]));
+			(is_base ? entry.base_actions : entry.new_actions) += std::stod(row["actions"]);
+			(is_base ? entry.base_expansions : entry.new_expansions) += std::stod(row["expansions"]);
+		}
+	};
+	add_rows(options.compare_base, true);
+	add_rows(options.compare_new, false);
+
+	size_t regressions = 0;
+	double log_ratio_sum = 0;
+	size_t ratio_count = 0;
+	std::cout << std::fixed << std::setprecision(2);
+	for (const auto& [key, entry] : entries) {
+		if (entry.base_runs == 0 || entry.new_runs == 0) {
+			std::cout << key << "\tonly in " << (entry.base_runs == 0 ? "new" : "base") << '\n';
+			continue;
+		}
+		auto base_finished = static_cast<double>(std::max<size_t>(entry.base_finished, 1));
+		auto new_finished = static_cast<double>(std::max<size_t>(entry.new_finished, 1));
+		auto base_actions = entry.base_actions / base_finished;
+		auto new_actions = entry.new_actions / new_finished;
+		auto base_expansions = entry.base_expansions / base_finished;
+		auto new_expansions = entry.new_expansions / new_finished;
+		auto p50_ratio = median(entry.new_p50) / std::max(median(entry.base_p50), 1.0);
+		auto p95_ratio = median(entry.new_p95) / std::max(median(entry.base_p95), 1.0);
+		bool measured = entry.base_finished > 0 && entry.new_finished > 0;
+		bool fewer_solved = entry.new_solved * entry.base_runs < entry.base_solved * entry.new_runs;
+		bool more_failed = entry.new_finished * entry.base_runs < entry.base_finished * entry.new_runs;
+		bool regressed = fewer_solved
+			|| more_failed
+			|| (measured && (new_actions > base_actions
+				|| new_expansions > base_expansions
+				|| p95_ratio > 1 + options.tolerance));
+		if (regressed) {
+			++regressions;
+		}
+		if (measured) {
+			log_ratio_sum += std::log(std::max(p50_ratio, 1e-9));
+			++ratio_count;
+		}
+		std::cout << key
+			<< "\tsolved " << entry.base_solved << "/" << entry.base_runs << " -> " << entry.new_solved << "/" << entry.new_runs
+			<< "\tfailed " << entry.base_runs - entry.base_finished << " -> " << entry.new_runs - entry.new_finished
+			<< "\tactions " << base_actions << " -> " << new_actions
+			<< "\texpansions " << base_expansions << " -> " << new_expansions
+			<< "\tp50 x" << p50_ratio
+			<< "\tp95 x" << p95_ratio
+			<< (regressed ? "\tREGRESSION" : "") << '\n';
+	}
+	if (ratio_count > 0) {
+		std::cout << "Geometric mean p50 ratio: " << std::exp(log_ratio_sum / ratio_count) << '\n';
+	}
+	std::cout << regressions << " regressions" << std::endl;
+	return regressions == 0 ? 0 : 1;
+}
+
+void print_usage() {
+	std::cerr << "Usage: bench [options]\n"
+		<< "  --levels GLOB        level files, wildcards in the file name (default ../levels/BD/*.txt)\n"
+		<< "  --planners LIST      comma separated mac, mac1 or still per agent, the last repeats (default mac)\n"
+		<< "  --agents N           agents per level (default 2)\n"
+		<< "  --seeds A[-B]        seed or inclusive seed range (default 0)\n"
+		<< "  --reps N             repetitions per level and seed (default 1)\n"
+		<< "  --max-actions N      action limit per run (default 100)\n"
+		<< "  --format csv|json    output format (default csv)\n"
+		<< "  --step-budget N      node expansions per MAC decision, searches become anytime (default no cap)\n"
+		<< "  --depth-slack N      added to last step's plan length to bound a goal's first search (default "
+			<< DEFAULT_DEPTH_BOUND_SLACK << ")\n"
+		<< "  --output FILE        write results to FILE instead of standard output\n"
+		<< "  --trace FILE         write planner phase spans of all runs as Chrome trace-event JSON\n"
+		<< "  --compare BASE NEW   compare two result files and exit non-zero on regressions\n"
+		<< "  --tolerance X        accepted relative p95 slowdown for --compare (default 0.1)\n";
+}
+
+Bench_Options parse_options(int argc, char* argv[]) {
+	Bench_Options options;
+	auto next = [&](int& index) -> std::string {
+		if (index + 1 >= argc) {
+			std::cerr << "Missing value for " << argv[index] << std::endl;
+			exit(-1);
+		}
+		return argv[++index];
+	};
+	for (int index = 1; index < argc; ++index) {
+		std::string argument = argv[index];
+		if (argument == "--levels") {
+			options.levels = next(index);
+		} else if (argument == "--planners") {
+			options.planner_types.clear();
+			for (const auto& name : split(next(index), ',')) {
+				options.planner_types.push_back(string_to_planner(name));
+			}
+		} else if (argument == "--agents") {
+			options.agents = std::stoul(next(index));
+		} else if (argument == "--seeds") {
+			auto range = split(next(index), '-');
+			options.seed_first = std::stoul(range.at(0));
+			options.seed_last = range.size() > 1 ? std::stoul(range.at(1)) : options.seed_first;
+		} else if (argument == "--reps") {
+			options.repetitions = std::stoul(next(index));
+		} else if (argument == "--max-actions") {
+			options.max_actions = std::stoul(next(index));
+		} else if (argument == "--format") {
+			options.format = next(index);
+		} else if (argument == "--step-budget") {
+			options.step_budget = std::stoul(next(index));
+		} else if (argument == "--depth-slack") {
+			options.depth_bound_slack = std::stoul(next(index));
+		} else if (argument == "--output") {
+			options.output = next(index);
+		} else if (argument == "--trace") {
+			options.trace = next(index);
+		} else if (argument == "--compare") {
+			options.compare_base = next(index);
+			options.compare_new = next(index);
+		} else if (argument == "--tolerance") {
+			options.tolerance = std::stod(next(index));
+		} else {
+			print_usage();
+			exit(argument == "--help" ? 0 : -1);
+		}
+	}
+	if (options.planner_types.empty() || options.agents == 0 || options.repetitions == 0
+		|| options.seed_last < options.seed_first || (options.format != "csv" && options.format != "json")) {
+		print_usage();
+		exit(-1);
+	}
+	return options;
+}
+
+// An assert or a library exit() ends the whole bench. The handlers write the run in progress
+// as failed and close the output, so the failure is recorded next to the runs before it.
+static std::ostream* abort_output = nullptr;
+static std::string abort_text;
+
+static void write_failed_run() {
+	if (abort_output != nullptr) {
+		*abort_output << abort_text << std::flush;
+		abort_output = nullptr;
+	}
+}
+
+static void write_failed_run_on_abort(int /*signal*/) {
+	write_failed_run();
+	std::_Exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+	auto options = parse_options(argc, argv);
+	if (!options.compare_base.empty()) {
+		return compare_results(options);
+	}
+
+	auto paths = get_level_paths(options.levels);
+	if (paths.empty()) {
+		std::cerr << "No levels match " << options.levels << std::endl;
+		return -1;
+	}
+
+	std::ofstream file;
+	if (!options.output.empty()) {
+		file.open(options.output);
+		if (!file) {
+			std::cerr << "Could not open output " << options.output << std::endl;
+			return -1;
+		}
+	}
+	auto& out = options.output.empty() ? std::cout : file;
+	out << format_header(options.format) << std::flush;
+	abort_output = &out;
+	std::signal(SIGABRT, write_failed_run_on_abort);
+	std::atexit(write_failed_run);
+
+	if (!options.trace.empty()) {
+		start_trace();
+	}
+	bool first_row = true;
+	for (const auto& path : paths) {
+		for (size_t seed = options.seed_first; seed <= options.seed_last; ++seed) {
+			for (size_t repetition = 0; repetition < options.repetitions; ++repetition) {
+				auto result = get_run_identity(path, options, seed, repetition);
+				result.failed = true;
+				abort_text = format_row(result, options.format, first_row) + format_footer(options.format, false);
+				try {
+					result = run_level(path, options, seed, repetition);
+					std::cerr << path << " seed " << seed << " rep " << repetition << ": "
+						<< result.actions << " actions, " << static_cast<size_t>(result.total_ms) << " ms, p95 "
+						<< static_cast<size_t>(result.p95_us) << " us" << std::endl;
+				} catch (const std::exception& exception) {
+					std::cerr << path << " seed " << seed << " rep " << repetition << ": failed, "
+						<< exception.what() << std::endl;
+				}
+				out << format_row(result, options.format, first_row) << std::flush;
+				first_row = false;
+			}
+		}
+	}
+	abort_output = nullptr;
+
+	if (!options.trace.empty()) {
+		write_trace(options.trace);
+	}
+	out << format_footer(options.format, first_row) << std::flush;
+	return 0;
+}
@@ -0,0 +1,407 @@
+
+#include "A_Star.hpp"
+#include "Environment.hpp"
+#include "Heuristic.hpp"
+#include "Planner_Mac.hpp"
+#include "Search_Trimmer.hpp"
+#include "State.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+Microbenchmarks for the simulation and search kernels. Every kernel runs over a
+fixed corpus built from the levels with a seeded random walk, so numbers from
+different commits measure the same work as long as the levels and the
+simulation rules are unchanged.
+
+Run from a project directory so the default level directory resolves, e.g.
+	microbench --filter heuristic --reps 10
+*/
+
+constexpr size_t AGENT_COUNT = 2;
+constexpr size_t WALK_STEPS = 200;			// States recorded per level
+constexpr size_t ACTIONS_PER_STATE = 8;		// Random joint actions tried per state
+constexpr size_t SEARCH_STATES = 4;			// States per level whose searches feed trim_forward and Action_Path
+
+struct Microbench_Options {
+	Microbench_Options() : levels("../levels/BD/"), filter(), seed(0), repetitions(5), min_time_ms(200), csv(false) {}
+	std::string levels;
+	std::string filter;		// Substring of the benchmark names to run, all if empty
+	size_t seed;
+	size_t repetitions;
+	size_t min_time_ms;		// Per repetition
+	bool csv;
+};
+
+struct Level_Corpus {
+	Level_Corpus(const std::string& path) : path(path), environment(AGENT_COUNT), states(), joint_actions(),
+		single_actions(), recipes(), goals(), paths() {}
+	std::string path;
+	Environment environment;
+	std::vector<State> states;
+	std::vector<Joint_Action> joint_actions;	// ACTIONS_PER_STATE per state
+	std::vector<Action> single_actions;			// ACTIONS_PER_STATE per state
+	std::vector<Recipe> recipes;
+	std::vector<Goal> goals;					// Goal and start state of every non-empty search path
+	std::vector<std::pair<size_t, std::vector<Joint_Action>>> paths;
+};
+
+// Random walk over all joint actions, invalid ones leave the state unchanged
+Level_Corpus build_corpus(const std::string& path, size_t seed) {
+	Level_Corpus corpus(path);
+	auto& environment = corpus.environment;
+	auto state = environment.load(path);
+	corpus.recipes = environment.get_all_recipes();
+
+	std::mt19937 engine(static_cast<unsigned>(seed));
+	Agent_Combination all_agents;
+	for (size_t agent = 0; agent < environment.get_number_of_agents(); ++agent) {
+		all_agents.add(Agent_Id{ agent });
+	}
+	auto joint_actions = environment.get_joint_actions(all_agents);
+	std::uniform_int_distribution<size_t> pick_action(0, joint_actions.size() - 1);
+	for (size_t step = 0; step < WALK_STEPS; ++step) {
+		corpus.states.push_back(state);
+		for (size_t i = 0; i < ACTIONS_PER_STATE; ++i) {
+			const auto& joint_action = joint_actions.at(pick_action(engine));
+			corpus.joint_actions.push_back(joint_action);
+			corpus.single_actions.push_back(joint_action.actions.at(i % joint_action.actions.size()));
+		}
+		environment.act(state, joint_actions.at(pick_action(engine)), Print_Level::NOPE);
+	}
+
+	A_Star search(environment, 100);
+	for (size_t i = 0; i < SEARCH_STATES; ++i) {
+		auto state_index = i * WALK_STEPS / SEARCH_STATES;
+		const auto& search_state = corpus.states.at(state_index);
+		for (const auto& recipe : environment.get_possible_recipes(search_state)) {
+			for (const auto& agents : get_combinations(environment.get_number_of_agents())) {
+				Agent_Id handoff_agent = agents.size() > 1 ? agents.get_largest() : Agent_Id{ EMPTY_VAL };
+				auto joint_path = search.search_joint(search_state, recipe, agents, handoff_agent, {}, {}, {});
+				if (!joint_path.empty()) {
+					corpus.goals.push_back(Goal(agents, recipe, handoff_agent));
+					corpus.paths.push_back({ state_index, joint_path });
+				}
+			}
+		}
+	}
+	return corpus;
+}
+
+struct Benchmark {
+	std::string name;
+	std::function<size_t(std::vector<Level_Corpus>&)> pass;	// Runs once over all corpora, returns operations done
+	std::function<size_t(std::vector<Level_Corpus>&)> count;	// Operations per pass, without running them
+};
+
+// Keeps results observable so the kernels are not optimised away
+static volatile size_t benchmark_sink = 0;
+
+std::vector<Benchmark> get_benchmarks() {
+	std::vector<Benchmark> benchmarks;
+	auto per_state = [](size_t multiplier) {
+		return [multiplier](std::vector<Level_Corpus>& corpora) {
+			size_t count = 0;
+			for (const auto& corpus : corpora) count += corpus.states.size() * multiplier;
+			return count;
+		};
+	};
+	auto per_path = [](std::vector<Level_Corpus>& corpora) {
+		size_t count = 0;
+		for (const auto& corpus : corpora) count += corpus.paths.size();
+		return count;
+	};
+
+	benchmarks.push_back({ "act_single", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			for (size_t i = 0; i < corpus.single_actions.size(); ++i) {
+				auto state = corpus.states[i / ACTIONS_PER_STATE];
+				benchmark_sink = benchmark_sink + corpus.environment.act(state, corpus.single_actions[i], Print_Level::NOPE);
+				++operations;
+			}
+		}
+		return operations;
+	}, per_state(ACTIONS_PER_STATE) });
+
+	benchmarks.push_back({ "act_joint", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			for (size_t i = 0; i < corpus.joint_actions.size(); ++i) {
+				auto state = corpus.states[i / ACTIONS_PER_STATE];
+				benchmark_sink = benchmark_sink + corpus.environment.act(state, corpus.joint_actions[i], Print_Level::NOPE);
+				++operations;
+			}
+		}
+		return operations;
+	}, per_state(ACTIONS_PER_STATE) });
+
+	benchmarks.push_back({ "state_copy", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			for (const auto& state : corpus.states) {
+				auto copy = state;
+				benchmark_sink = benchmark_sink + copy.to_hash();
+				++operations;
+			}
+		}
+		return operations;
+	}, per_state(1) });
+
+	benchmarks.push_back({ "contains_collisions", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			for (size_t i = 0; i < corpus.joint_actions.size(); ++i) {
+				benchmark_sink = benchmark_sink
+					+ corpus.environment.contains_collisions(corpus.states[i / ACTIONS_PER_STATE], corpus.joint_actions[i]);
+				++operations;
+			}
+		}
+		return operations;
+	}, per_state(ACTIONS_PER_STATE) });
+
+	benchmarks.push_back({ "state_to_hash", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			for (const auto& state : corpus.states) {
+				benchmark_sink = benchmark_sink + state.to_hash();
+				++operations;
+			}
+		}
+		return operations;
+	}, per_state(1) });
+
+	// Neighbouring states of a walk are often equal, which exercises the full comparison
+	benchmarks.push_back({ "state_equals", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			for (size_t i = 1; i < corpus.states.size(); ++i) {
+				benchmark_sink = benchmark_sink + (corpus.states[i] == corpus.states[i - 1]);
+				++operations;
+			}
+		}
+		return operations;
+	}, [](std::vector<Level_Corpus>& corpora) {
+		size_t count = 0;
+		for (const auto& corpus : corpora) count += corpus.states.size() - 1;
+		return count;
+	} });
+
+	// Heuristic set up for every recipe and agent combination, evaluated on every state
+	benchmarks.push_back({ "heuristic", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			Heuristic heuristic(corpus.environment);
+			for (const auto& recipe : corpus.recipes) {
+				for (const auto& agents : get_combinations(corpus.environment.get_number_of_agents())) {
+					Agent_Id handoff_agent = agents.size() > 1 ? agents.get_largest() : Agent_Id{ EMPTY_VAL };
+					heuristic.set(recipe.ingredient1, recipe.ingredient2, agents, handoff_agent);
+					for (const auto& state : corpus.states) {
+						benchmark_sink = benchmark_sink + heuristic(state, agents, handoff_agent);
+						++operations;
+					}
+				}
+			}
+		}
+		return operations;
+	}, [](std::vector<Level_Corpus>& corpora) {
+		size_t count = 0;
+		for (const auto& corpus : corpora) {
+			count += corpus.recipes.size() * get_combinations(corpus.environment.get_number_of_agents()).size()
+				* corpus.states.size();
+		}
+		return count;
+	} });
+
+	// Heuristic cache key, paid on every lookup hit or miss
+	benchmarks.push_back({ "heuristic_projection", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			for (const auto& recipe : corpus.recipes) {
+				for (const auto& state : corpus.states) {
+					auto projection = state.get_projection(recipe.ingredient1, recipe.ingredient2, Ingredient::CUTTING);
+					benchmark_sink = benchmark_sink + projection.to_hash();
+					++operations;
+				}
+			}
+		}
+		return operations;
+	}, [](std::vector<Level_Corpus>& corpora) {
+		size_t count = 0;
+		for (const auto& corpus : corpora) {
+			count += corpus.recipes.size() * corpus.states.size();
+		}
+		return count;
+	} });
+
+	// Replaces Heuristic::init, which the shared table took over
+	benchmarks.push_back({ "distance_table_build", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			Distance_Table table(corpus.environment);
+			benchmark_sink = benchmark_sink + table.get_distance({ 1, 1 }, { 1, 1 }, 0);
+			++operations;
+		}
+		return operations;
+	}, [](std::vector<Level_Corpus>& corpora) {
+		return corpora.size();
+	} });
+
+	benchmarks.push_back({ "trim_forward", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		Search_Trimmer trimmer;
+		for (auto& corpus : corpora) {
+			for (size_t i = 0; i < corpus.paths.size(); ++i) {
+				auto path = corpus.paths[i].second;
+				trimmer.trim_forward(path, corpus.states[corpus.paths[i].first], corpus.environment, corpus.goals[i].recipe);
+				benchmark_sink = benchmark_sink + path.size();
+				++operations;
+			}
+		}
+		return operations;
+	}, per_path });
+
+	benchmarks.push_back({ "action_path", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			for (size_t i = 0; i < corpus.paths.size(); ++i) {
+				Action_Path action_path(corpus.paths[i].second, corpus.goals[i], corpus.states[corpus.paths[i].first],
+					corpus.environment);
+				benchmark_sink = benchmark_sink + action_path.size();
+				++operations;
+			}
+		}
+		return operations;
+	}, per_path });
+
+	benchmarks.push_back({ "do_ingredients_lead_to_goal", [](std::vector<Level_Corpus>& corpora) {
+		size_t operations = 0;
+		for (auto& corpus : corpora) {
+			for (const auto& state : corpus.states) {
+				benchmark_sink = benchmark_sink
+					+ corpus.environment.do_ingredients_lead_to_goal(state.get_ingredients_count());
+				++operations;
+			}
+		}
+		return operations;
+	}, per_state(1) });
+
+	return benchmarks;
+}
+
+void print_usage() {
+	std::cerr << "Usage: microbench [options]\n"
+		<< "  --levels DIR      level directory for the corpus (default ../levels/BD/)\n"
+		<< "  --filter TEXT     only run benchmarks whose name contains TEXT\n"
+		<< "  --seed N          corpus random walk seed (default 0)\n"
+		<< "  --reps N          timed repetitions per benchmark, the median is reported (default 5)\n"
+		<< "  --min-time MS     minimum time per repetition (default 200)\n"
+		<< "  --csv             print csv instead of a table\n";
+}
+
+Microbench_Options parse_options(int argc, char* argv[]) {
+	Microbench_Options options;
+	auto next = [&](int& index) -> std::string {
+		if (index + 1 >= argc) {
+			std::cerr << "Missing value for " << argv[index] << std::endl;
+			exit(-1);
+		}
+		return argv[++index];
+	};
+	for (int index = 1; index < argc; ++index) {
+		std::string argument = argv[index];
+		if (argument == "--levels") {
+			options.levels = next(index);
+		} else if (argument == "--filter") {
+			options.filter = next(index);
+		} else if (argument == "--seed") {
+			options.seed = std::stoul(next(index));
+		} else if (argument == "--reps") {
+			options.repetitions = std::stoul(next(index));
+		} else if (argument == "--min-time") {
+			options.min_time_ms = std::stoul(next(index));
+		} else if (argument == "--csv") {
+			options.csv = true;
+		} else {
+			print_usage();
+			exit(argument == "--help" ? 0 : -1);
+		}
+	}
+	if (options.repetitions == 0) {
+		print_usage();
+		exit(-1);
+	}
+	return options;
+}
+
+int main(int argc, char* argv[]) {
+	auto options = parse_options(argc, argv);
+
+	std::vector<std::string> paths;
+	for (const auto& entry : std::filesystem::directory_iterator(options.levels)) {
+		if (entry.path().extension() == ".txt") {
+			paths.push_back(entry.path().generic_string());
+		}
+	}
+	std::sort(paths.begin(), paths.end());
+	if (paths.empty()) {
+		std::cerr << "No levels in " << options.levels << std::endl;
+		return -1;
+	}
+
+	std::vector<Level_Corpus> corpora;
+	for (const auto& path : paths) {
+		corpora.push_back(build_corpus(path, options.seed));
+	}
+
+	if (options.csv) {
+		std::cout << "benchmark,operations,median_ns,min_ns\n";
+	} else {
+		std::cout << std::left << std::setw(30) << "benchmark" << std::right << std::setw(12) << "operations"
+			<< std::setw(14) << "median ns/op" << std::setw(14) << "min ns/op" << '\n';
+	}
+	for (const auto& benchmark : get_benchmarks()) {
+		if (benchmark.name.find(options.filter) == std::string::npos) {
+			continue;
+		}
+		auto operations_per_pass = benchmark.count(corpora);
+
+		// Warm up caches and lazily built tables
+		benchmark.pass(corpora);
+
+		std::vector<double> ns_per_operation;
+		for (size_t repetition = 0; repetition < options.repetitions; ++repetition) {
+			size_t operations = 0;
+			auto time_start = std::chrono::steady_clock::now();
+			auto time_end = time_start;
+			do {
+				operations += benchmark.pass(corpora);
+				time_end = std::chrono::steady_clock::now();
+			} while (time_end - time_start < std::chrono::milliseconds(options.min_time_ms));
+			auto elapsed_ns = std::chrono::duration<double, std::nano>(time_end - time_start).count();
+			ns_per_operation.push_back(elapsed_ns / std::max<size_t>(operations, 1));
+		}
+		std::sort(ns_per_operation.begin(), ns_per_operation.end());
+		auto median = ns_per_operation.at(ns_per_operation.size() / 2);
+		auto minimum = ns_per_operation.front();
+
+		if (options.csv) {
+			std::cout << benchmark.name << ',' << operations_per_pass << ',' << std::fixed << std::setprecision(1)
+				<< median << ',' << minimum << '\n';
+		} else {
+			std::cout << std::left << std::setw(30) << benchmark.name << std::right << std::setw(12) << operations_per_pass
+				<< std::fixed << std::setprecision(1) << std::setw(14) << median << std::setw(14) << minimum << '\n';
+		}
+		std::cout.flush();
+	}
+	return 0;
+}
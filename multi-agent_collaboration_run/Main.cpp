@@ -5,6 +5,7 @@
 #include "Planner_Mac_One.hpp"
 #include "Planner_Still.hpp"
 #include "State.hpp"
+#include "Trace.hpp"
 
 #include <iostream>
 #include <chrono>
@@ -13,6 +14,7 @@
 #include <fstream>
 
 #define PLAY 0
+#define TRACE 0
 
 std::vector<std::string> get_all_files(std::string base_path) {
 	std::vector<std::string> paths;
@@ -43,14 +45,15 @@ Solution solve_inner(const std::string& path, const std::vector<Planner_Types>&
 	size_t action_count = 0;
 	auto time_start = std::chrono::system_clock::now();
 	std::vector<Planner> planners;
+	auto context = std::make_shared<Planning_Context>(environment, state);	// Shared by the MAC planners
 	for (size_t agent = 0; agent < environment.get_number_of_agents(); ++agent) {
 		switch (planner_types.at(agent)) {
 		case Planner_Types::MAC: {
-			planners.emplace_back(std::make_unique<Planner_Mac>(environment, agent, state, seed));
+			planners.emplace_back(std::make_unique<Planner_Mac>(environment, agent, state, seed, context));
 			break;
 		}
 		case Planner_Types::MAC_ONE: {
-			planners.emplace_back(std::make_unique<Planner_Mac_One>(environment, agent, state, seed));
+			planners.emplace_back(std::make_unique<Planner_Mac_One>(environment, agent, state, seed, context));
 			break;
 		}
 		case Planner_Types::STILL: {
@@ -78,6 +81,7 @@ Solution solve_inner(const std::string& path, const std::vector<Planner_Types>&
 	auto time_end = std::chrono::system_clock::now();
 
 	auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(time_end - time_start).count();
+	flush_print();
 	std::cout << "Total time: " << diff << std::endl;
 	std::cout << "Actions: " << action_count << std::endl;
 	return Solution{ diff, action_count, path, planner_types.at(0), planner_types.at(1), seed };
@@ -115,6 +119,7 @@ void write_solutions(const std::vector<Solution>& solutions) {
 	size_t sum_mac = 0;
 	size_t count_mac = 0;
 	std::stringstream buffer;
+	flush_print();
 	for (const auto& solution : solutions) {
 
 		size_t length = solution.actions;
@@ -242,7 +247,9 @@ int main(int argc, char* argv[]) {
 		environment.print_state(state);
 		environment.play(state);
 	} else {
+		if (TRACE) start_trace();
 		solve();
+		if (TRACE) write_trace("../results/trace.json");
 	}
 
 	return 0;
@@ -10,11 +10,14 @@ module1 = Extension('mac_interface',
                                'multi-agent_collaboration/Core.cpp',
                                'multi-agent_collaboration/Environment.cpp',
                                'multi-agent_collaboration/Heuristic.cpp',
+                               'multi-agent_collaboration/Plan_Cache.cpp',
                                'multi-agent_collaboration/Planner_Mac.cpp',
                                'multi-agent_collaboration/Planner_Still.cpp',
                                'multi-agent_collaboration/Search_Trimmer.cpp',
                                'multi-agent_collaboration/Sliding_Recogniser.cpp',
                                'multi-agent_collaboration/State.cpp',
+                               'multi-agent_collaboration/Thread_Pool.cpp',
+                               'multi-agent_collaboration/Trace.cpp',
                                'multi-agent_collaboration/Utils.cpp'])
 
 